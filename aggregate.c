@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "potato-aggregate.h"
+#include "potato-port.h"
+
+static void startBatch(PbAggregator* agg)
+{
+  agg->count = 0;
+
+  if (agg->format == PbAggregateJson) {
+
+    agg->array = jsonStartArray(jsonGenerate(&agg->json, (char*)agg->buf, agg->size));
+    return;
+  }
+
+  agg->len = 2;
+}
+
+void pbAggregateInit(PbAggregator* agg,
+                     PbClient* client,
+                     const char* topic,
+                     PbAggregateFormat format,
+                     int window,
+                     void* buf,
+                     int size)
+{
+  agg->client = client;
+  agg->topic  = topic;
+  agg->format = format;
+  agg->window = window;
+  agg->buf    = buf;
+  agg->size   = size;
+
+  startBatch(agg);
+}
+
+static bool addJson(PbAggregator* agg, double value)
+{
+  JsonContext saved = agg->json;
+
+  // Generator cannot undo a partial write, so
+  // restore saved state if value didn't fit.
+  // One byte must be left for closing bracket.
+  jsonWriteDouble(agg->array, value);
+  if (jsonFailed(&agg->json) || agg->json.left < 1) {
+
+    agg->json = saved;
+    return false;
+  }
+
+  return true;
+}
+
+static bool addBinary(PbAggregator* agg, double value)
+{
+  union {
+
+    float    f;
+    uint32_t u;
+  } v;
+
+  if (agg->len + 4 > agg->size || agg->count == 0xffff)
+    return false;
+
+  v.f = value;
+  agg->buf[agg->len++] = v.u >> 24;
+  agg->buf[agg->len++] = v.u >> 16;
+  agg->buf[agg->len++] = v.u >> 8;
+  agg->buf[agg->len++] = v.u;
+  return true;
+}
+
+static bool add(PbAggregator* agg, double value)
+{
+  bool ok;
+
+  if (agg->format == PbAggregateJson)
+    ok = addJson(agg, value);
+  else
+    ok = addBinary(agg, value);
+
+  if (!ok)
+    return false;
+
+  if (agg->count == 0)
+    agg->started = pbClock();
+
+  agg->count++;
+  return true;
+}
+
+int pbAggregateFlush(PbAggregator* agg)
+{
+  PbPublish pub;
+  int       st;
+
+  if (agg->count == 0)
+    return PB_SUCCESS;
+
+  memset(&pub, '\0', sizeof(pub));
+  pub.topic = agg->topic;
+  pub.message = agg->buf;
+
+  if (agg->format == PbAggregateJson) {
+
+    jsonGenerateFlush(agg->array);
+    pub.len = strlen((char*)agg->buf);
+  }
+  else {
+
+    agg->buf[0] = agg->count >> 8;
+    agg->buf[1] = agg->count;
+    pub.len = agg->len;
+  }
+
+  st = pbPublish(agg->client, &pub);
+  startBatch(agg);
+  return st;
+}
+
+int pbAggregatePoll(PbAggregator* agg)
+{
+  if (agg->count > 0 && pbClock() - agg->started >= (int64_t)agg->window * 1000)
+    return pbAggregateFlush(agg);
+
+  return PB_SUCCESS;
+}
+
+int pbAggregate(PbAggregator* agg, double value)
+{
+  int st;
+
+  st = pbAggregatePoll(agg);
+  if (st < 0)
+    return st;
+
+  if (add(agg, value))
+    return PB_SUCCESS;
+
+  // Batch is full.
+  st = pbAggregateFlush(agg);
+  if (st < 0)
+    return st;
+
+  if (!add(agg, value))
+    return PB_TOOBIG;
+
+  return PB_SUCCESS;
+}
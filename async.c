@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#ifdef USE_UNIX_SOCKETS
+
+#include <sys/socket.h>
+#include <poll.h>
+
+#else
+
+#include <picoos.h>
+#include <picoos-lwip.h>
+
+#endif
+
+#include "potato-bus.h"
+#include "potato-port.h"
+#include "potato-async.h"
+#include "potato-stats.h"
+
+void pbAsyncInit(PbAsync* op, int timeout)
+{
+  memset(op, '\0', sizeof(PbAsync));
+  op->sock    = -1;
+  op->timeout = timeout;
+}
+
+bool pbAsyncBusy(const PbAsync* op)
+{
+  return op->pt != 0;
+}
+
+int pbAsyncCheck(PbClient* client, PbAsync* op)
+{
+  if (op->pt == 0) {
+
+    op->wait     = PB_ASYNC_NONE;
+    op->pos      = 0;
+    op->len      = -1;
+    op->deadline = op->timeout ? pbClock() + (int64_t)op->timeout * 1000 : 0;
+    return PB_SUCCESS;
+  }
+
+  if (op->deadline == 0 || pbClock() < op->deadline)
+    return PB_SUCCESS;
+
+  // Partial packet may have been transferred, so
+  // connection cannot be used anymore.
+  if (client->stats != NULL)
+    client->stats->timeouts++;
+
+  if (client->sock != -1)
+    pbDisconnectSocket(client);
+
+  op->pt   = 0;
+  op->wait = PB_ASYNC_NONE;
+  return PB_TIMEOUT;
+}
+
+int pbAsyncRead(PbClient* client, PbAsync* op, uint8_t* buf, int len)
+{
+  int got;
+
+  got = client->readPacket(client, buf, len);
+  if (got >= 0) {
+
+    op->wait = PB_ASYNC_NONE;
+    return got;
+  }
+
+  if (errno == EAGAIN || errno == EWOULDBLOCK) {
+
+    op->wait = PB_ASYNC_READ;
+    op->sock = client->sock;
+    return PB_WOULDBLOCK;
+  }
+
+  op->wait = PB_ASYNC_NONE;
+  return PB_NETWORK;
+}
+
+int pbAsyncWrite(PbClient* client, PbAsync* op, const uint8_t* buf, int len)
+{
+  int sent;
+
+  while (op->pos < len) {
+
+    sent = client->writePacket(client, buf + op->pos, len - op->pos);
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+
+      op->wait = PB_ASYNC_WRITE;
+      op->sock = client->sock;
+      return PB_WOULDBLOCK;
+    }
+
+    if (sent <= 0) {
+
+      op->wait = PB_ASYNC_NONE;
+      op->pos  = 0;
+      return PB_NETWORK;
+    }
+
+    op->pos += sent;
+  }
+
+  op->wait = PB_ASYNC_NONE;
+  op->pos  = 0;
+  return PB_SUCCESS;
+}
+
+int pbAsyncWait(PbAsync* const* ops, int count, int timeout)
+{
+#ifdef USE_UNIX_SOCKETS
+
+  // poll handles descriptors above FD_SETSIZE.
+  struct pollfd fds[count > 0 ? count : 1];
+  int           n = 0;
+  int           i;
+  int           st;
+
+  for (i = 0; i < count; i++) {
+
+    if (ops[i]->wait == PB_ASYNC_NONE || ops[i]->sock == -1)
+      continue;
+
+    fds[n].fd      = ops[i]->sock;
+    fds[n].events  = ops[i]->wait == PB_ASYNC_READ ? POLLIN : POLLOUT;
+    fds[n].revents = 0;
+    ++n;
+  }
+
+  // Nothing could ever wake up.
+  if (n == 0 && timeout < 0)
+    return 0;
+
+  st = poll(fds, n, timeout);
+
+#else
+
+  fd_set         rset;
+  fd_set         wset;
+  struct timeval tmo;
+  int            maxFd = -1;
+  int            i;
+  int            st;
+
+  FD_ZERO(&rset);
+  FD_ZERO(&wset);
+  for (i = 0; i < count; i++) {
+
+    if (ops[i]->wait == PB_ASYNC_NONE || ops[i]->sock == -1)
+      continue;
+
+    if (ops[i]->sock >= FD_SETSIZE)
+      return PB_ERROR;
+
+    if (ops[i]->wait == PB_ASYNC_READ)
+      FD_SET(ops[i]->sock, &rset);
+    else
+      FD_SET(ops[i]->sock, &wset);
+
+    if (ops[i]->sock > maxFd)
+      maxFd = ops[i]->sock;
+  }
+
+  // Nothing could ever wake up.
+  if (maxFd == -1 && timeout < 0)
+    return 0;
+
+  if (timeout >= 0) {
+
+    tmo.tv_sec  = timeout / 1000;
+    tmo.tv_usec = (timeout % 1000) * 1000;
+  }
+
+  st = select(maxFd + 1, &rset, &wset, NULL, timeout >= 0 ? &tmo : NULL);
+
+#endif
+
+  if (st < 0)
+    return errno == EINTR ? 0 : PB_ERROR;
+
+  return st;
+}
@@ -0,0 +1,995 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "potato-broker.h"
+
+#if POTATO_BROKER
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "potato-port.h"
+
+#define LISTEN_EVENT(n) (POTATO_BROKER_SESSIONS + (n))
+
+static void setAdd(PbBrokerSet* set, int n)
+{
+  set->bits[n / 32] |= 1u << (n % 32);
+}
+
+static void setRemove(PbBrokerSet* set, int n)
+{
+  set->bits[n / 32] &= ~(1u << (n % 32));
+}
+
+static void setMerge(PbBrokerSet* set, const PbBrokerSet* other)
+{
+  int i;
+
+  for (i = 0; i < PB_BROKER_WORDS; i++)
+    set->bits[i] |= other->bits[i];
+}
+
+static bool setEmpty(const PbBrokerSet* set)
+{
+  int i;
+
+  for (i = 0; i < PB_BROKER_WORDS; i++)
+    if (set->bits[i])
+      return false;
+
+  return true;
+}
+
+/*
+ * Topic tree.
+ */
+
+static bool levelIs(const PbBrokerNode* node, const char* level, int len)
+{
+  return (int)strlen(node->level) == len && !memcmp(node->level, level, len);
+}
+
+static int findChild(PbBroker* broker, int parent, const char* level, int len)
+{
+  int i;
+
+  for (i = broker->nodes[parent].child; i != -1; i = broker->nodes[i].next)
+    if (levelIs(&broker->nodes[i], level, len))
+      return i;
+
+  return -1;
+}
+
+static int addChild(PbBroker* broker, int parent, const char* level, int len)
+{
+  PbBrokerNode* node;
+  int           i;
+
+  i = broker->freeNode;
+  if (i == -1)
+    return -1;
+
+  node = &broker->nodes[i];
+  broker->freeNode = node->next;
+
+  memset(&node->subs, '\0', sizeof(node->subs));
+  memcpy(node->level, level, len);
+  node->level[len] = '\0';
+  node->child = -1;
+  node->next = broker->nodes[parent].child;
+  broker->nodes[parent].child = i;
+  return i;
+}
+
+/*
+ * Check that subscription filter is valid:
+ * wildcards must occupy whole level and # must be last.
+ */
+static bool validFilter(const char* filter)
+{
+  const char* level = filter;
+  const char* ptr;
+
+  for (ptr = filter; ; ptr++) {
+
+    if (*ptr == '/' || *ptr == '\0') {
+
+      if (ptr - level >= POTATO_BROKER_LEVEL)
+        return false;
+
+      if (*ptr == '\0')
+        return true;
+
+      level = ptr + 1;
+      continue;
+    }
+
+    if (*ptr == '+' || *ptr == '#') {
+
+      if (ptr != level || (ptr[1] != '/' && ptr[1] != '\0'))
+        return false;
+
+      if (*ptr == '#' && ptr[1] != '\0')
+        return false;
+    }
+  }
+}
+
+/*
+ * Find node for filter. If create is set, missing
+ * nodes are added.
+ */
+static int filterNode(PbBroker* broker, const char* filter, bool create)
+{
+  const char* sep;
+  int         node = 0;
+  int         child;
+  int         len;
+
+  while (true) {
+
+    sep = strchr(filter, '/');
+    len = sep ? sep - filter : (int)strlen(filter);
+
+    child = findChild(broker, node, filter, len);
+    if (child == -1 && create)
+      child = addChild(broker, node, filter, len);
+
+    if (child == -1)
+      return -1;
+
+    node = child;
+    if (sep == NULL)
+      return node;
+
+    filter = sep + 1;
+  }
+}
+
+/*
+ * Return unused nodes below link to free list.
+ */
+static void prune(PbBroker* broker, int16_t* link)
+{
+  PbBrokerNode* node;
+  int           i;
+
+  while (*link != -1) {
+
+    i = *link;
+    node = &broker->nodes[i];
+    prune(broker, &node->child);
+
+    if (node->child == -1 && setEmpty(&node->subs)) {
+
+      *link = node->next;
+      node->next = broker->freeNode;
+      broker->freeNode = i;
+    }
+    else
+      link = &node->next;
+  }
+}
+
+/*
+ * Collect sessions subscribed to topic below parent node.
+ * Wildcards at first level don't match topics starting with $.
+ */
+static void match(PbBroker* broker, int parent, const char* topic, const char* end, PbBrokerSet* set)
+{
+  const char*   sep;
+  PbBrokerNode* node;
+  bool          wild;
+  int           len;
+  int           i;
+  int           c;
+
+  sep = memchr(topic, '/', end - topic);
+  len = (sep ? sep : end) - topic;
+  wild = parent != 0 || topic[0] != '$';
+
+  for (i = broker->nodes[parent].child; i != -1; i = node->next) {
+
+    node = &broker->nodes[i];
+    if (!strcmp(node->level, "#")) {
+
+      if (wild)
+        setMerge(set, &node->subs);
+
+      continue;
+    }
+
+    if (!(wild && !strcmp(node->level, "+")) && !levelIs(node, topic, len))
+      continue;
+
+    if (sep != NULL) {
+
+      match(broker, i, sep + 1, end, set);
+      continue;
+    }
+
+    // Last level, "a/#" matches also "a".
+    setMerge(set, &node->subs);
+    for (c = node->child; c != -1; c = broker->nodes[c].next)
+      if (!strcmp(broker->nodes[c].level, "#"))
+        setMerge(set, &broker->nodes[c].subs);
+  }
+}
+
+/*
+ * Sessions.
+ */
+
+static void watch(PbBroker* broker, int n, bool output)
+{
+  struct epoll_event ev;
+
+  ev.events = EPOLLIN | (output ? EPOLLOUT : 0);
+  ev.data.u32 = n;
+  epoll_ctl(broker->epoll, EPOLL_CTL_MOD, broker->sessions[n].fd, &ev);
+}
+
+static void closeSession(PbBroker* broker, int n);
+
+/*
+ * Close session that has been silent for 1.5 times
+ * keepalive or hasn't sent CONNECT in time.
+ */
+static void sessionExpired(void* ctx)
+{
+  PbBrokerSession* s = ctx;
+
+  closeSession(s->broker, s - s->broker->sessions);
+}
+
+static void restartTimer(PbBroker* broker, PbBrokerSession* s)
+{
+  if (!s->connected)
+    pbTimerStart(&broker->timers, &s->timer, POTATO_BROKER_CONNECT_TIME);
+  else if (s->keepAlive > 0)
+    pbTimerStart(&broker->timers, &s->timer, s->keepAlive * 1500);
+  else
+    pbTimerCancel(&broker->timers, &s->timer);
+}
+
+static void closeSession(PbBroker* broker, int n)
+{
+  PbBrokerSession* s = &broker->sessions[n];
+  int              i;
+
+  if (s->fd == -1)
+    return;
+
+  epoll_ctl(broker->epoll, EPOLL_CTL_DEL, s->fd, NULL);
+  close(s->fd);
+
+  pbTimerCancel(&broker->timers, &s->timer);
+  s->fd = -1;
+  s->connected = false;
+  s->inLen = 0;
+  s->outLen = 0;
+  s->clientId[0] = '\0';
+
+  for (i = 0; i < POTATO_BROKER_NODES; i++)
+    setRemove(&broker->nodes[i].subs, n);
+
+  prune(broker, &broker->nodes[0].child);
+}
+
+/*
+ * Send data to session. If socket doesn't take all of it,
+ * rest is queued and sent when socket is writable. If
+ * there is no room in queue, data is dropped. Returns false
+ * if session was closed.
+ */
+static bool sendBytes(PbBroker* broker, int n, const unsigned char* buf, int len)
+{
+  PbBrokerSession* s = &broker->sessions[n];
+  int              st;
+
+  if (s->outLen > 0) {
+
+    if (len > (int)sizeof(s->out) - s->outLen) {
+
+      ++broker->dropped;
+      return true;
+    }
+
+    memcpy(s->out + s->outLen, buf, len);
+    s->outLen += len;
+    return true;
+  }
+
+  st = send(s->fd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+  if (st == len)
+    return true;
+
+  if (st < 0) {
+
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+
+      closeSession(broker, n);
+      return false;
+    }
+
+    st = 0;
+  }
+
+  memcpy(s->out, buf + st, len - st);
+  s->outLen = len - st;
+  watch(broker, n, true);
+  return true;
+}
+
+static bool sendPacket(PbBroker* broker, int n, PbPacket* pkt)
+{
+  return sendBytes(broker, n, pkt->start, pkt->end - pkt->start);
+}
+
+static void flushSession(PbBroker* broker, int n)
+{
+  PbBrokerSession* s = &broker->sessions[n];
+  int              st;
+
+  st = send(s->fd, s->out, s->outLen, MSG_NOSIGNAL | MSG_DONTWAIT);
+  if (st < 0) {
+
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+      closeSession(broker, n);
+
+    return;
+  }
+
+  s->outLen -= st;
+  memmove(s->out, s->out + st, s->outLen);
+  if (s->outLen == 0)
+    watch(broker, n, false);
+}
+
+/*
+ * Send publish packet to all subscribers of topic.
+ */
+static int deliver(PbBroker* broker, const char* topic, int topicLen, const unsigned char* buf, int len)
+{
+  PbBrokerSet set;
+  int         count = 0;
+  int         w;
+  int         n;
+  uint32_t    bits;
+  uint32_t    dropped;
+
+  memset(&set, '\0', sizeof(set));
+  match(broker, 0, topic, topic + topicLen, &set);
+
+  for (w = 0; w < PB_BROKER_WORDS; w++) {
+
+    bits = set.bits[w];
+    while (bits) {
+
+      n = w * 32 + __builtin_ctz(bits);
+      bits &= bits - 1;
+
+      dropped = broker->dropped;
+      if (broker->sessions[n].connected && sendBytes(broker, n, buf, len) && broker->dropped == dropped) {
+
+        ++broker->delivered;
+        ++count;
+      }
+    }
+  }
+
+  return count;
+}
+
+static bool validTopic(const char* topic, int len)
+{
+  return len > 0 && memchr(topic, '+', len) == NULL && memchr(topic, '#', len) == NULL;
+}
+
+static void handleConnect(PbBroker* broker, int n, PbPacket* pkt)
+{
+  PbBrokerSession* s = &broker->sessions[n];
+  PbConnect        conn;
+  PbConnectAck     ack;
+  int              level;
+  int              i;
+
+  level = pbReadConnect(pkt, &conn);
+  if (level == -1) {
+
+    closeSession(broker, n);
+    return;
+  }
+
+  memset(&ack, '\0', sizeof(ack));
+  if (level != 3 && level != 4)
+    ack.returnCode = 1; // unacceptable protocol version
+  else if (strlen(conn.clientId) >= sizeof(s->clientId))
+    ack.returnCode = 2; // identifier rejected
+
+  pbWriteConnectAck(&broker->tx, &ack);
+  if (!sendPacket(broker, n, &broker->tx))
+    return;
+
+  if (ack.returnCode != 0) {
+
+    closeSession(broker, n);
+    return;
+  }
+
+  // New connection with same client id takes over.
+  if (conn.clientId[0] != '\0')
+    for (i = 0; i < POTATO_BROKER_SESSIONS; i++)
+      if (i != n && broker->sessions[i].connected && !strcmp(broker->sessions[i].clientId, conn.clientId))
+        closeSession(broker, i);
+
+  strcpy(s->clientId, conn.clientId);
+  s->keepAlive = conn.keepAlive;
+  s->connected = true;
+  restartTimer(broker, s);
+}
+
+static void handlePublish(PbBroker* broker, int n, PbPacket* pkt)
+{
+  const unsigned char* topic;
+  PbPublish            pub;
+  int                  topicLen;
+  int                  qos;
+
+  ++broker->published;
+  qos = (pkt->start[0] >> 1) & 3;
+  if (qos == 3) {
+
+    closeSession(broker, n);
+    return;
+  }
+
+  // Plain QOS 0 packet is passed on as is.
+  if ((pkt->start[0] & 0xf) == 0) {
+
+    topicLen = pbPublishTopic(pkt->start, pkt->end - pkt->start, &topic);
+    if (!validTopic((const char*)topic, topicLen)) {
+
+      closeSession(broker, n);
+      return;
+    }
+
+    deliver(broker, (const char*)topic, topicLen, pkt->start, pkt->end - pkt->start);
+    return;
+  }
+
+  // Otherwise encode it again as QOS 0.
+  pub.message = NULL;
+  topicLen = pbPublishTopic(pkt->start, pkt->end - pkt->start, &topic);
+  if (topicLen == -1 || pkt->end - (topic + topicLen) < (qos ? 2 : 0)) {
+
+    closeSession(broker, n);
+    return;
+  }
+
+  pbReadPublish(pkt, &pub);
+  topicLen = strlen(pub.topic);
+  if (!validTopic(pub.topic, topicLen)) {
+
+    closeSession(broker, n);
+    return;
+  }
+
+  if (qos == 1) {
+
+    pbWritePublishAck(&broker->tx, pub.packetId);
+    if (!sendPacket(broker, n, &broker->tx))
+      return;
+  }
+  else if (qos == 2) { // exactly once delivery needs state, not supported
+
+    closeSession(broker, n);
+    return;
+  }
+
+  if (pbWritePublish(&broker->tx, &pub) == -1)
+    return;
+
+  deliver(broker, pub.topic, topicLen, broker->tx.start, broker->tx.end - broker->tx.start);
+}
+
+static void handleSubscribe(PbBroker* broker, int n, PbPacket* pkt)
+{
+  PbSubscribe sub;
+  uint8_t     codes[POTATO_BUFSIZE / 4];
+  int         count = 0;
+  int         node;
+  int         st;
+
+  memset(&sub, '\0', sizeof(sub));
+  if ((pkt->start[0] & 0xf) != 2) {
+
+    closeSession(broker, n);
+    return;
+  }
+
+  while ((st = pbReadSubscribe(pkt, &sub)) == 1) {
+
+    node = validFilter(sub.topic) ? filterNode(broker, sub.topic, true) : -1;
+    if (node == -1) {
+
+      codes[count++] = 0x80; // failure
+      continue;
+    }
+
+    setAdd(&broker->nodes[node].subs, n);
+    codes[count++] = 0; // granted QOS 0
+  }
+
+  if (st == -1) {
+
+    closeSession(broker, n);
+    return;
+  }
+
+  pbWriteSubAck(&broker->tx, sub.packetId, codes, count);
+  sendPacket(broker, n, &broker->tx);
+}
+
+static void handleUnsubscribe(PbBroker* broker, int n, PbPacket* pkt)
+{
+  PbSubscribe sub;
+  int         node;
+  int         st;
+
+  memset(&sub, '\0', sizeof(sub));
+  if ((pkt->start[0] & 0xf) != 2) {
+
+    closeSession(broker, n);
+    return;
+  }
+
+  while ((st = pbReadUnsubscribe(pkt, &sub)) == 1) {
+
+    node = filterNode(broker, sub.topic, false);
+    if (node != -1)
+      setRemove(&broker->nodes[node].subs, n);
+  }
+
+  if (st == -1) {
+
+    closeSession(broker, n);
+    return;
+  }
+
+  prune(broker, &broker->nodes[0].child);
+  pbWriteUnsubAck(&broker->tx, sub.packetId);
+  sendPacket(broker, n, &broker->tx);
+}
+
+static void handlePacket(PbBroker* broker, int n, unsigned char* buf, int len)
+{
+  PbBrokerSession* s = &broker->sessions[n];
+  PbPacket         pkt;
+  int              type;
+
+  pbNewPacket(&pkt);
+  pkt.start = buf;
+  pkt.ptr = buf;
+  pkt.end = buf + len;
+
+  type = buf[0] >> 4;
+  // CONNECT must be first packet and only once.
+  if (s->connected == (type == PB_MQ_CONNECT)) {
+
+    closeSession(broker, n);
+    return;
+  }
+
+  switch (type) {
+    case PB_MQ_CONNECT:
+      handleConnect(broker, n, &pkt);
+      break;
+
+    case PB_MQ_PUBLISH:
+      handlePublish(broker, n, &pkt);
+      break;
+
+    case PB_MQ_SUBSCRIBE:
+      handleSubscribe(broker, n, &pkt);
+      break;
+
+    case PB_MQ_UNSUBSCRIBE:
+      handleUnsubscribe(broker, n, &pkt);
+      break;
+
+    case PB_MQ_PINGREQ:
+      pbWritePingResp(&broker->tx);
+      sendPacket(broker, n, &broker->tx);
+      break;
+
+    case PB_MQ_DISCONNECT:
+      closeSession(broker, n);
+      break;
+
+    default:
+      // Acks for QOS > 0 are not expected as broker sends only QOS 0.
+      break;
+  }
+}
+
+/*
+ * Decode remaining length of packet in buf. Returns
+ * fixed header length, 0 if header is not complete yet
+ * or -1 if it is invalid.
+ */
+static int decodeLength(const unsigned char* buf, int avail, int* len)
+{
+  int hdr = 1;
+  int mul = 1;
+
+  *len = 0;
+  while (true) {
+
+    if (hdr >= avail)
+      return 0;
+
+    *len += (buf[hdr] & 0x7f) * mul;
+    if (!(buf[hdr++] & 0x80))
+      return hdr;
+
+    if (hdr > 4)
+      return -1;
+
+    mul *= 128;
+  }
+}
+
+/*
+ * Read from session socket and handle all
+ * complete packets in input buffer.
+ */
+static void readSession(PbBroker* broker, int n)
+{
+  PbBrokerSession* s = &broker->sessions[n];
+  int              st;
+  int              pos;
+  int              hdr;
+  int              len;
+
+  st = recv(s->fd, s->in + s->inLen, sizeof(s->in) - s->inLen, 0);
+  if (st <= 0) {
+
+    if (st == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+      closeSession(broker, n);
+
+    return;
+  }
+
+  s->inLen += st;
+  restartTimer(broker, s);
+
+  pos = 0;
+  while (true) {
+
+    hdr = decodeLength(s->in + pos, s->inLen - pos, &len);
+    if (hdr == 0)
+      break;
+
+    if (hdr == -1 || hdr + len > (int)sizeof(s->in)) {
+
+      closeSession(broker, n);
+      return;
+    }
+
+    if (s->inLen - pos < hdr + len)
+      break;
+
+    handlePacket(broker, n, s->in + pos, hdr + len);
+    if (s->fd == -1)
+      return;
+
+    pos += hdr + len;
+  }
+
+  s->inLen -= pos;
+  memmove(s->in, s->in + pos, s->inLen);
+}
+
+static void acceptSessions(PbBroker* broker, int l)
+{
+  PbBrokerSession*   s;
+  struct epoll_event ev;
+  int                fd;
+  int                n;
+  int                one = 1;
+
+  while ((fd = accept(broker->listen[l], NULL, NULL)) != -1) {
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    for (n = 0; n < POTATO_BROKER_SESSIONS; n++)
+      if (broker->sessions[n].fd == -1)
+        break;
+
+    if (n == POTATO_BROKER_SESSIONS) {
+
+      close(fd);
+      continue;
+    }
+
+    if (broker->tcp[l])
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    ev.events = EPOLLIN;
+    ev.data.u32 = n;
+    if (epoll_ctl(broker->epoll, EPOLL_CTL_ADD, fd, &ev) == -1) {
+
+      close(fd);
+      continue;
+    }
+
+    s = &broker->sessions[n];
+    s->fd = fd;
+    s->connected = false;
+    s->keepAlive = 0;
+    s->inLen = 0;
+    s->outLen = 0;
+    restartTimer(broker, s);
+  }
+}
+
+int pbBrokerInit(PbBroker* broker)
+{
+  int i;
+
+  memset(broker, '\0', sizeof(PbBroker));
+  pbNewPacket(&broker->tx);
+
+  broker->epoll = epoll_create1(EPOLL_CLOEXEC);
+  if (broker->epoll == -1)
+    return PB_ERROR;
+
+  for (i = 0; i < POTATO_BROKER_LISTEN; i++)
+    broker->listen[i] = -1;
+
+  for (i = 0; i < POTATO_BROKER_SESSIONS; i++) {
+
+    broker->sessions[i].fd = -1;
+    broker->sessions[i].broker = broker;
+    pbTimerInit(&broker->sessions[i].timer, sessionExpired, &broker->sessions[i]);
+  }
+
+  broker->nodes[0].child = -1;
+  broker->nodes[0].next = -1;
+  for (i = 1; i < POTATO_BROKER_NODES; i++)
+    broker->nodes[i].next = i + 1 < POTATO_BROKER_NODES ? i + 1 : -1;
+
+  broker->freeNode = POTATO_BROKER_NODES > 1 ? 1 : -1;
+  pbTimerWheelInit(&broker->timers);
+  return PB_SUCCESS;
+}
+
+static int listenUnix(const PbUrl* url)
+{
+  struct sockaddr_un addr;
+  int                fd;
+
+  if (strlen(url->path) >= sizeof(addr.sun_path))
+    return -1;
+
+  memset(&addr, '\0', sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, url->path);
+  unlink(url->path);
+
+  fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd == -1)
+    return -1;
+
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(fd, 64) == -1) {
+
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+static int listenTcp(const PbUrl* url)
+{
+  struct addrinfo  hints;
+  struct addrinfo* res;
+  const char*      host = url->host;
+  int              fd;
+  int              one = 1;
+
+  if (host[0] == '\0' || !strcmp(host, "*"))
+    host = NULL;
+
+  memset(&hints, '\0', sizeof(hints));
+  hints.ai_family   = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags    = AI_PASSIVE;
+
+  if (getaddrinfo(host, url->port ? url->port : "1883", &hints, &res) != 0)
+    return -1;
+
+  fd = socket(res->ai_family, res->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, res->ai_protocol);
+  if (fd != -1) {
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, res->ai_addr, res->ai_addrlen) == -1 || listen(fd, 64) == -1) {
+
+      close(fd);
+      fd = -1;
+    }
+  }
+
+  freeaddrinfo(res);
+  return fd;
+}
+
+int pbBrokerListen(PbBroker* broker, const char* url)
+{
+  struct epoll_event ev;
+  char               urlBuf[128];
+  PbUrl              u;
+  bool               tcp;
+  int                fd;
+  int                l;
+
+  for (l = 0; l < POTATO_BROKER_LISTEN; l++)
+    if (broker->listen[l] == -1)
+      break;
+
+  if (l == POTATO_BROKER_LISTEN)
+    return PB_ERROR;
+
+  strlcpy(urlBuf, url, sizeof(urlBuf));
+  if (pbUrlTok(&u, urlBuf) == -1)
+    return PB_BADURL;
+
+  tcp = !strcmp(u.protocol, "mqtt") || !strcmp(u.protocol, "tcp");
+  if (tcp)
+    fd = listenTcp(&u);
+  else if (!strcmp(u.protocol, "unix"))
+    fd = listenUnix(&u);
+  else
+    return PB_BADURL;
+
+  if (fd == -1)
+    return PB_NETWORK;
+
+  ev.events = EPOLLIN;
+  ev.data.u32 = LISTEN_EVENT(l);
+  if (epoll_ctl(broker->epoll, EPOLL_CTL_ADD, fd, &ev) == -1) {
+
+    close(fd);
+    return PB_NETWORK;
+  }
+
+  broker->listen[l] = fd;
+  broker->tcp[l] = tcp;
+  return PB_SUCCESS;
+}
+
+int pbBrokerPoll(PbBroker* broker, int timeout)
+{
+  struct epoll_event events[16];
+  uint32_t           n;
+  int                count;
+  int                next;
+  int                i;
+
+  pbTimerWheelRun(&broker->timers);
+  next = pbTimerWheelNext(&broker->timers);
+  if (next >= 0 && (timeout < 0 || next < timeout))
+    timeout = next;
+
+  count = epoll_wait(broker->epoll, events, 16, timeout);
+  if (count == -1) {
+
+    if (errno != EINTR)
+      return PB_ERROR;
+
+    count = 0;
+  }
+
+  for (i = 0; i < count; i++) {
+
+    n = events[i].data.u32;
+    if (n >= LISTEN_EVENT(0)) {
+
+      acceptSessions(broker, n - LISTEN_EVENT(0));
+      continue;
+    }
+
+    if (broker->sessions[n].fd == -1)
+      continue;
+
+    if (events[i].events & EPOLLOUT)
+      flushSession(broker, n);
+
+    if (broker->sessions[n].fd == -1)
+      continue;
+
+    if (events[i].events & EPOLLIN)
+      readSession(broker, n);
+    else if (events[i].events & (EPOLLHUP | EPOLLERR))
+      closeSession(broker, n);
+  }
+
+  pbTimerWheelRun(&broker->timers);
+  return count;
+}
+
+int pbBrokerPublish(PbBroker* broker, PbPublish* pub)
+{
+  int topicLen = strlen(pub->topic);
+
+  if (!validTopic(pub->topic, topicLen))
+    return PB_ERROR;
+
+  if (pbWritePublish(&broker->tx, pub) == -1)
+    return PB_TOOBIG;
+
+  ++broker->published;
+  return deliver(broker, pub->topic, topicLen, broker->tx.start, broker->tx.end - broker->tx.start);
+}
+
+void pbBrokerClose(PbBroker* broker)
+{
+  int i;
+
+  for (i = 0; i < POTATO_BROKER_SESSIONS; i++)
+    closeSession(broker, i);
+
+  for (i = 0; i < POTATO_BROKER_LISTEN; i++)
+    if (broker->listen[i] != -1) {
+
+      close(broker->listen[i]);
+      broker->listen[i] = -1;
+    }
+
+  close(broker->epoll);
+  broker->epoll = -1;
+}
+
+#endif
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef USE_UNIX_SOCKETS
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#endif
+
+#include "potato-capture.h"
+#include "potato-port.h"
+
+static void put32(unsigned char* ptr, uint32_t value)
+{
+  ptr[0] = value;
+  ptr[1] = value >> 8;
+  ptr[2] = value >> 16;
+  ptr[3] = value >> 24;
+}
+
+static int captureRead(PbClient* client, unsigned char* buf, size_t len)
+{
+  PbCapture*    cap = client->capture;
+  unsigned char hdr[PB_CAPTURE_RECORD];
+  int64_t       now;
+  int           st;
+
+  st = cap->readPacket(client, buf, len);
+  if (cap->error)
+    return st;
+
+  now = pbClock();
+  put32(hdr, now - cap->last);
+  put32(hdr + 4, st);
+  cap->last = now;
+
+  if (cap->write(cap->ctx, hdr, sizeof(hdr)) < 0 ||
+      (st > 0 && cap->write(cap->ctx, buf, st) < 0))
+    cap->error = PB_ERROR;
+
+  return st;
+}
+
+int pbCaptureInit(PbCapture* cap, int (*write)(void* ctx, const void* buf, int len), void* ctx)
+{
+  unsigned char hdr[PB_CAPTURE_HEADER];
+
+  cap->write = write;
+  cap->ctx   = ctx;
+  cap->error = 0;
+  cap->last  = pbClock();
+
+  memcpy(hdr, PB_CAPTURE_MAGIC, 4);
+  hdr[4] = PB_CAPTURE_VERSION;
+  hdr[5] = 0;
+  hdr[6] = 0;
+  hdr[7] = 0;
+
+  if (write(ctx, hdr, sizeof(hdr)) < 0) {
+
+    cap->error = PB_ERROR;
+    return PB_ERROR;
+  }
+
+  return PB_SUCCESS;
+}
+
+void pbCaptureAttach(PbClient* client)
+{
+  if (client->readPacket == captureRead)
+    return;
+
+  client->capture->readPacket = client->readPacket;
+  client->readPacket = captureRead;
+}
+
+#ifdef USE_UNIX_SOCKETS
+
+static uint32_t get32(const unsigned char* ptr)
+{
+  return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+static int fileWrite(void* ctx, const void* buf, int len)
+{
+  if (fwrite(buf, 1, len, (FILE*)ctx) != (size_t)len)
+    return -1;
+
+  return len;
+}
+
+int pbCaptureOpen(PbCapture* cap, const char* path)
+{
+  FILE* f;
+
+  f = fopen(path, "wb");
+  if (f == NULL)
+    return PB_ERROR;
+
+  if (pbCaptureInit(cap, fileWrite, f) != PB_SUCCESS) {
+
+    fclose(f);
+    return PB_ERROR;
+  }
+
+  return PB_SUCCESS;
+}
+
+int pbCaptureClose(PbCapture* cap)
+{
+  if (fclose((FILE*)cap->ctx) != 0 || cap->error)
+    return PB_ERROR;
+
+  return PB_SUCCESS;
+}
+
+unsigned char* pbReplayLoad(const char* path, size_t* size)
+{
+  FILE*          f;
+  unsigned char* data;
+  long           len;
+
+  f = fopen(path, "rb");
+  if (f == NULL)
+    return NULL;
+
+  if (fseek(f, 0, SEEK_END) != 0 || (len = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0) {
+
+    fclose(f);
+    return NULL;
+  }
+
+  data = malloc(len > 0 ? len : 1);
+  if (data != NULL && fread(data, 1, len, f) != (size_t)len) {
+
+    free(data);
+    data = NULL;
+  }
+
+  fclose(f);
+  *size = len;
+  return data;
+}
+
+static int replayRead(PbClient* client, unsigned char* buf, size_t len)
+{
+  PbReplay* rp = client->transportCtx;
+  int64_t   wait;
+  int       st;
+
+  if (rp->left == 0) {
+
+    // Start next captured read. Capture cut short
+    // in record header ends replay.
+    if (rp->pos + PB_CAPTURE_RECORD > rp->size) {
+
+      rp->pos = rp->size;
+      return -1;
+    }
+
+    rp->due += get32(rp->data + rp->pos);
+    st = (int32_t)get32(rp->data + rp->pos + 4);
+    rp->pos += PB_CAPTURE_RECORD;
+
+    if (rp->realtime) {
+
+      wait = rp->due - pbClock();
+      if (wait > 0)
+        usleep(wait);
+    }
+
+    if (st <= 0)
+      return st;
+
+    if (rp->pos + st > rp->size) {
+
+      rp->pos = rp->size;
+      return -1;
+    }
+
+    rp->left = st;
+  }
+
+  if (len > (size_t)rp->left)
+    len = rp->left;
+
+  memcpy(buf, rp->data + rp->pos, len);
+  rp->pos  += len;
+  rp->left -= len;
+  return len;
+}
+
+static int replayWrite(PbClient* client, const unsigned char* buf, size_t len)
+{
+  return len;
+}
+
+static int replayFlush(PbClient* client)
+{
+  return 0;
+}
+
+static int replayClose(PbClient* client)
+{
+  return close(client->sock);
+}
+
+int pbReplayStart(PbClient* client, PbReplay* rp, const unsigned char* data, size_t size, bool realtime)
+{
+  if (size < PB_CAPTURE_HEADER || memcmp(data, PB_CAPTURE_MAGIC, 4) || data[4] != PB_CAPTURE_VERSION)
+    return PB_ERROR;
+
+  // Client closes socket on errors, so give it
+  // a real descriptor.
+  client->sock = open("/dev/null", O_RDWR);
+  if (client->sock == -1)
+    return PB_NETWORK;
+
+  rp->data     = data;
+  rp->size     = size;
+  rp->pos      = PB_CAPTURE_HEADER;
+  rp->left     = 0;
+  rp->realtime = realtime;
+  rp->due      = pbClock();
+
+  client->transportCtx    = rp;
+  client->corked          = false;
+  client->writePacket     = replayWrite;
+  client->readPacket      = replayRead;
+  client->flushPacket     = replayFlush;
+  client->closeConnection = replayClose;
+  return PB_SUCCESS;
+}
+
+bool pbReplayEnd(const PbReplay* rp)
+{
+  return rp->pos >= rp->size;
+}
+
+#endif
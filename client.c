@@ -32,14 +32,19 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
 
 #include <string.h>
 
 #ifdef USE_UNIX_SOCKETS
 
 #include <sys/socket.h>
+#include <poll.h>
+#include <sys/un.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 
 #else
 
@@ -49,49 +54,218 @@
 #endif
 
 #include "potato-bus.h"
+#include "potato-port.h"
+#include "potato-latency.h"
+#include "potato-stats.h"
+#include "potato-trace.h"
+#include "potato-capture.h"
+#include "potato-impair.h"
+#include "potato-shm.h"
+#include "potato-timer.h"
+#include "potato-async.h"
+
+#if POTATO_KTLS
+
+#include <linux/tls.h>
+#include "mbedtls/ssl_ciphersuites.h"
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+
+#endif
 
 static int writePlainPacket(PbClient* client, const unsigned char* buf, size_t len)
 {
+  if (client->stats != NULL)
+    client->stats->writes++;
+
   return write(client->sock, buf, len);
 }
 
 static int readPlainPacket(PbClient* client, unsigned char* buf, size_t len)
 {
+  if (client->stats != NULL)
+    client->stats->reads++;
+
   return read(client->sock, buf, len);
 }
 
+static int flushPlainPacket(PbClient* client)
+{
+  return 0;
+}
+
 static int closePlainConnection(PbClient* client)
 {
   return close(client->sock);
 }
 
+/*
+ * Wait until socket is readable or writable. Timeout is in
+ * milliseconds, -1 = forever. Returns > 0 when ready, 0 on
+ * timeout. lwIP doesn't necessarily have poll (LWIP_SOCKET_POLL),
+ * but its descriptors are small, so select is used there.
+ */
+static int waitSocket(int sock, bool write, int timeout)
+{
+#ifdef USE_UNIX_SOCKETS
+
+  struct pollfd pfd;
+
+  pfd.fd      = sock;
+  pfd.events  = write ? POLLOUT : POLLIN;
+  pfd.revents = 0;
+  return poll(&pfd, 1, timeout);
+
+#else
+
+  fd_set         set;
+  struct timeval tmo;
+
+  FD_ZERO(&set);
+  FD_SET(sock, &set);
+  tmo.tv_sec  = timeout / 1000;
+  tmo.tv_usec = (timeout % 1000) * 1000;
+  return select(sock + 1, write ? NULL : &set, write ? &set : NULL, NULL, timeout >= 0 ? &tmo : NULL);
+
+#endif
+}
+
 #if POTATO_TLS
 
 static int sslWrite(void* ctx, const unsigned char* buf, size_t len)
 {
   PbClient* client = (PbClient*)ctx;
 
-  return write(client->sock, buf, len);
+  int       st;
+
+  if (client->stats != NULL)
+    client->stats->writes++;
+
+  st = write(client->sock, buf, len);
+  if (st < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    return MBEDTLS_ERR_SSL_WANT_WRITE;
+
+  return st;
 }
 
+/*
+ * Read as much ciphertext as socket has available
+ * into buffer and serve mbedtls from there. This way
+ * record header and body don't need separate system calls.
+ */
 static int sslRead(void* ctx, unsigned char*buf, size_t len)
 {
   PbClient* client = (PbClient*)ctx;
+  int       st;
 
-  return read(client->sock, buf, len);
+  if (client->sslInPos == client->sslInLen) {
+
+    if (client->stats != NULL)
+      client->stats->reads++;
+
+    // Large read with empty buffer can go directly to caller.
+    if (len >= sizeof(client->sslIn))
+      return read(client->sock, buf, len);
+
+    st = read(client->sock, client->sslIn, sizeof(client->sslIn));
+    if (st <= 0)
+      return st;
+
+    client->sslInPos = 0;
+    client->sslInLen = st;
+  }
+
+  if (len > (size_t)(client->sslInLen - client->sslInPos))
+    len = client->sslInLen - client->sslInPos;
+
+  memcpy(buf, client->sslIn + client->sslInPos, len);
+  client->sslInPos += len;
+  return len;
 }
 
-static int writeSslPacket(PbClient* client, const unsigned char* buf, size_t len)
+static int sslWriteAll(PbClient* client, const unsigned char* buf, size_t len)
 {
   int st;
 
-  st = mbedtls_ssl_write(&client->ssl, buf, len);
-  if (st < 0)
-    client->sslResult = st;
+  while (len > 0) {
+
+    st = mbedtls_ssl_write(&client->ssl, buf, len);
+    if (st == MBEDTLS_ERR_SSL_WANT_READ || st == MBEDTLS_ERR_SSL_WANT_WRITE) {
+
+      // Wait until socket is ready instead of spinning.
+      if (waitSocket(client->sock, st == MBEDTLS_ERR_SSL_WANT_WRITE, -1) < 0 && errno != EINTR) {
 
+        client->sslResult = st;
+        return st;
+      }
+
+      continue;
+    }
+
+    if (st < 0) {
+
+      client->sslResult = st;
+      return st;
+    }
+
+    buf += st;
+    len -= st;
+  }
+
+  return 0;
+}
+
+/*
+ * Send plaintext collected by writeSslPacket
+ * as a single TLS record.
+ */
+static int flushSslPacket(PbClient* client)
+{
+  int st;
+
+  if (client->sslOutLen == 0)
+    return 0;
+
+  st = sslWriteAll(client, client->sslOut, client->sslOutLen);
+  client->sslOutLen = 0;
   return st;
 }
 
+/*
+ * Collect plaintext into buffer until flush, so that
+ * several small writes share one TLS record.
+ */
+static int writeSslPacket(PbClient* client, const unsigned char* buf, size_t len)
+{
+  int st;
+
+  if (len > sizeof(client->sslOut) - client->sslOutLen) {
+
+    st = flushSslPacket(client);
+    if (st < 0)
+      return st;
+
+    if (len > sizeof(client->sslOut)) {
+
+      st = sslWriteAll(client, buf, len);
+      if (st < 0)
+        return st;
+
+      return len;
+    }
+  }
+
+  memcpy(client->sslOut + client->sslOutLen, buf, len);
+  client->sslOutLen += len;
+  return len;
+}
+
 static int readSslPacket(PbClient* client, unsigned char* buf, size_t len)
 {
   int st;
@@ -104,6 +278,125 @@ static int readSslPacket(PbClient* client, unsigned char* buf, size_t len)
 }
 
 static int closeSslConnection(PbClient* client)
+{
+  // Send data still collected in buffer, for
+  // example DISCONNECT written while corked.
+  flushSslPacket(client);
+  mbedtls_ssl_close_notify(&client->ssl);
+  mbedtls_ssl_free(&client->ssl);
+  return close(client->sock);
+}
+
+#if POTATO_KTLS
+
+/*
+ * Key export callback from mbedtls. Key block contains
+ * client and server MAC keys, encryption keys and
+ * fixed IVs. For AES-GCM MAC keys are empty.
+ */
+static int exportKeys(void* ctx,
+                      const unsigned char* ms,
+                      const unsigned char* kb,
+                      size_t macLen,
+                      size_t keyLen,
+                      size_t ivLen)
+{
+  PbClient* client = (PbClient*)ctx;
+
+  if (macLen != 0 || keyLen > 32 || ivLen != 4)
+    return 0;
+
+  memcpy(client->ktlsKeys, kb, 2 * keyLen + 2 * ivLen);
+  client->ktlsKeyLen = keyLen;
+  return 0;
+}
+
+typedef union {
+
+  struct tls_crypto_info                 info;
+  struct tls12_crypto_info_aes_gcm_128   gcm128;
+  struct tls12_crypto_info_aes_gcm_256   gcm256;
+} CryptoInfo;
+
+static int cryptoInfo(CryptoInfo* ci,
+                      int keyLen,
+                      const unsigned char* key,
+                      const unsigned char* salt,
+                      const unsigned char* seq)
+{
+  memset(ci, '\0', sizeof(CryptoInfo));
+  ci->info.version = TLS_1_2_VERSION;
+
+  if (keyLen == TLS_CIPHER_AES_GCM_128_KEY_SIZE) {
+
+    ci->info.cipher_type = TLS_CIPHER_AES_GCM_128;
+    memcpy(ci->gcm128.key, key, keyLen);
+    memcpy(ci->gcm128.salt, salt, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+    memcpy(ci->gcm128.iv, seq, TLS_CIPHER_AES_GCM_128_IV_SIZE);
+    memcpy(ci->gcm128.rec_seq, seq, TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE);
+    return sizeof(ci->gcm128);
+  }
+
+  ci->info.cipher_type = TLS_CIPHER_AES_GCM_256;
+  memcpy(ci->gcm256.key, key, keyLen);
+  memcpy(ci->gcm256.salt, salt, TLS_CIPHER_AES_GCM_256_SALT_SIZE);
+  memcpy(ci->gcm256.iv, seq, TLS_CIPHER_AES_GCM_256_IV_SIZE);
+  memcpy(ci->gcm256.rec_seq, seq, TLS_CIPHER_AES_GCM_256_REC_SEQ_SIZE);
+  return sizeof(ci->gcm256);
+}
+
+/*
+ * Hand record encryption over to kernel TLS after
+ * mbedtls handshake. Returns 1 if kernel took over,
+ * 0 if connection must stay in mbedtls and negative
+ * value if socket is no longer usable.
+ */
+static int enableKtls(PbClient* client)
+{
+  const mbedtls_ssl_ciphersuite_t* suite;
+  const unsigned char* kb = client->ktlsKeys;
+  int        keyLen = client->ktlsKeyLen;
+  CryptoInfo ci;
+  int        len;
+  int        st;
+
+  // Right after TLS 1.2 handshake both sides have sent
+  // exactly one record (Finished) with new keys, so next
+  // sequence number is 1 in both directions.
+  static const unsigned char seq[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+  if (keyLen == 0)
+    return 0;
+
+  // Only TLS 1.2 with AES-GCM is supported.
+  suite = mbedtls_ssl_ciphersuite_from_id(mbedtls_ssl_get_ciphersuite_id(mbedtls_ssl_get_ciphersuite(&client->ssl)));
+  if (suite == NULL ||
+      strcmp(mbedtls_ssl_get_version(&client->ssl), "TLSv1.2") ||
+      (suite->cipher != MBEDTLS_CIPHER_AES_128_GCM && suite->cipher != MBEDTLS_CIPHER_AES_256_GCM))
+    return 0;
+
+  // Ciphertext that has already been read from socket
+  // cannot be given to kernel.
+  if (client->sslInPos != client->sslInLen || mbedtls_ssl_get_bytes_avail(&client->ssl) > 0)
+    return 0;
+
+  if (setsockopt(client->sock, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) != 0)
+    return 0;
+
+  // Key block: client key, server key, client iv, server iv.
+  len = cryptoInfo(&ci, keyLen, kb, kb + 2 * keyLen, seq);
+  st  = setsockopt(client->sock, SOL_TLS, TLS_TX, &ci, len);
+  if (st == 0) {
+
+    len = cryptoInfo(&ci, keyLen, kb + keyLen, kb + 2 * keyLen + 4, seq);
+    st  = setsockopt(client->sock, SOL_TLS, TLS_RX, &ci, len);
+  }
+
+  memset(&ci, '\0', sizeof(ci));
+  return st == 0 ? 1 : -1;
+}
+
+static int closeKtlsConnection(PbClient* client)
 {
   mbedtls_ssl_free(&client->ssl);
   return close(client->sock);
@@ -111,6 +404,8 @@ static int closeSslConnection(PbClient* client)
 
 #endif
 
+#endif
+
 bool pbIsSSL_URL(const char* url)
 {
   char* ptr;
@@ -127,54 +422,496 @@ bool pbIsSSL_URL(const char* url)
   return false;
 }
 
-int pbConnectSocket(PbClient*            client,
-                    const PbUrl*         url,
-                    mbedtls_ssl_config*  sslConf)
+static int setBlocking(int sock, bool blocking)
 {
-  struct addrinfo hints;
-  struct addrinfo *res, *resOrig;
-  int    i;
+  int flags;
 
-#if POTATO_TLS
-  int    st;
+  flags = fcntl(sock, F_GETFL, 0);
+  if (flags == -1)
+    return -1;
 
-  client->sslResult = 0;
-#endif
+  if (blocking)
+    flags &= ~O_NONBLOCK;
+  else
+    flags |= O_NONBLOCK;
+
+  return fcntl(sock, F_SETFL, flags);
+}
+
+/*
+ * Order addresses so that address families alternate,
+ * starting with the family of first address (RFC 8305).
+ */
+static int sortAddresses(struct addrinfo* res, PbAddress* addrs, int max)
+{
+  struct addrinfo* first;
+  struct addrinfo* other;
+  struct addrinfo* ai;
+  int    family;
+  int    count = 0;
+
+  family = res->ai_family;
+  first  = res;
+  other  = res;
+
+  while (count < max && (first != NULL || other != NULL)) {
+
+    while (first != NULL && first->ai_family != family)
+      first = first->ai_next;
+
+    while (other != NULL && other->ai_family == family)
+      other = other->ai_next;
+
+    ai = first != NULL ? first : other;
+    if (first != NULL && (count & 1) && other != NULL)
+      ai = other;
+
+    if (ai == first)
+      first = first->ai_next;
+    else
+      other = other->ai_next;
+
+    if (ai->ai_addrlen > sizeof(addrs[count].addr))
+      continue;
+
+    addrs[count].family = ai->ai_family;
+    addrs[count].len    = ai->ai_addrlen;
+    memcpy(&addrs[count].addr, ai->ai_addr, ai->ai_addrlen);
+    ++count;
+  }
+
+  return count;
+}
+
+int pbResolve(const char* host, const char* port, PbAddress* addrs, int max)
+{
+  struct addrinfo  hints;
+  struct addrinfo* res;
+  int              count;
 
   memset(&hints, '\0', sizeof(hints));
 
   hints.ai_family = PF_UNSPEC;
   hints.ai_socktype = SOCK_STREAM;
 
-  i = getaddrinfo(url->host, url->port, &hints, &res);
-  if (i != 0) {
+  if (getaddrinfo(host, port, &hints, &res) != 0)
+    return -1;
 
-    return PB_NETWORK;
+  count = sortAddresses(res, addrs, max);
+  freeaddrinfo(res);
+  return count;
+}
+
+/*
+ * Start non-blocking connect. Returns socket or -1.
+ */
+static int startConnect(const PbAddress* addr, bool* done)
+{
+  int sock;
+
+  *done = false;
+  sock = socket(addr->family, SOCK_STREAM, 0);
+  if (sock < 0)
+    return -1;
+
+  if (setBlocking(sock, false) == -1) {
+
+    close(sock);
+    return -1;
   }
 
-  resOrig = res;
-  client->sock = -1;
+  if (connect(sock, (const struct sockaddr*)&addr->addr, addr->len) == 0) {
 
-  while (res) {
+    *done = true;
+    return sock;
+  }
 
-    client->sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-    if (client->sock >= 0) {
+  if (errno != EINPROGRESS) {
 
-      if (connect(client->sock, res->ai_addr, res->ai_addrlen) == 0)
+    close(sock);
+    return -1;
+  }
+
+  return sock;
+}
+
+#ifdef USE_UNIX_SOCKETS
+
+/*
+ * Connect to host using all addresses resolved for it.
+ * Connection attempts are started with POTATO_CONNECT_DELAY
+ * stagger and raced against each other. First one to complete
+ * wins and rest are closed. If timeout (milliseconds) is
+ * nonzero, give up after it has elapsed. Returns socket,
+ * PB_TIMEOUT or PB_NETWORK.
+ */
+static int connectTcp(const PbUrl* url, int timeout)
+{
+  PbAddress        addrs[POTATO_CONNECT_ADDRS];
+  int              socks[POTATO_CONNECT_ATTEMPTS];
+  int              addrCount;
+  int              active = 0;
+  int              next = 0;
+  int              sock = -1;
+  int              st = PB_NETWORK;
+  int              i;
+  bool             done;
+  int64_t          now;
+  int64_t          deadline;
+  int64_t          nextStart;
+
+  addrCount = pbEndpointResolve(url, addrs, POTATO_CONNECT_ADDRS);
+  if (addrCount <= 0)
+    return PB_NETWORK;
+
+  now = pbClock();
+  deadline  = timeout ? now + (int64_t)timeout * 1000 : 0;
+  nextStart = now;
+
+  while (sock == -1) {
+
+    now = pbClock();
+    if (deadline && now >= deadline) {
+
+      st = PB_TIMEOUT;
+      break;
+    }
+
+    // Start next attempt if stagger delay has passed
+    // or there is nothing in progress.
+    if (next < addrCount && active < POTATO_CONNECT_ATTEMPTS &&
+        (now >= nextStart || active == 0)) {
+
+      socks[active] = startConnect(&addrs[next++], &done);
+      if (socks[active] == -1) {
+
+        nextStart = now;
+        continue;
+      }
+
+      if (done) {
+
+        sock = socks[active++];
         break;
+      }
 
-      close(client->sock);
-      client->sock = -1;
+      ++active;
+      nextStart = now + POTATO_CONNECT_DELAY * 1000;
+      continue;
+    }
+
+    if (active == 0)
+      break;
+
+    // Wait until some attempt completes or it is
+    // time to start the next one. poll is used because
+    // descriptors may be above FD_SETSIZE.
+    struct pollfd  fds[POTATO_CONNECT_ATTEMPTS];
+    int64_t        wait = -1;
+    int            ready;
+
+    for (i = 0; i < active; i++) {
+
+      fds[i].fd      = socks[i];
+      fds[i].events  = POLLOUT;
+      fds[i].revents = 0;
     }
 
-    res = res->ai_next;
+    if (next < addrCount && active < POTATO_CONNECT_ATTEMPTS)
+      wait = nextStart - now;
+
+    if (deadline && (wait == -1 || deadline - now < wait))
+      wait = deadline - now;
+
+    // Round up so that poll doesn't return just
+    // before deadline.
+    ready = poll(fds, active, wait >= 0 ? (int)((wait + 999) / 1000) : -1);
+    if (ready < 0 && errno != EINTR)
+      break;
+
+    if (ready <= 0)
+      continue;
+
+    for (i = active - 1; i >= 0; i--) {
+
+      if (fds[i].revents == 0)
+        continue;
+
+      int       err = -1;
+      socklen_t errLen = sizeof(err);
+
+      if (getsockopt(socks[i], SOL_SOCKET, SO_ERROR, &err, &errLen) == 0 && err == 0) {
+
+        sock = socks[i];
+        break;
+      }
+
+      // This one failed, drop it and try next address immediately.
+      close(socks[i]);
+      socks[i] = socks[--active];
+      fds[i]   = fds[active];
+      nextStart = now;
+    }
+  }
+
+  // Cancel attempts that lost the race.
+  for (i = 0; i < active; i++)
+    if (socks[i] != sock)
+      close(socks[i]);
+
+  if (sock == -1)
+    return st;
+
+  if (setBlocking(sock, true) == -1) {
+
+    close(sock);
+    return PB_NETWORK;
+  }
+
+  return sock;
+}
+
+#else
+
+/*
+ * Connect to resolved addresses one at a time using
+ * blocking connect. Racing attempts would need poll,
+ * which lwIP doesn't necessarily provide. Timeout is
+ * not applied, lwIP connect uses its own retransmission
+ * limits. Returns socket or PB_NETWORK.
+ */
+static int connectTcp(const PbUrl* url, int timeout)
+{
+  PbAddress addrs[POTATO_CONNECT_ADDRS];
+  int       addrCount;
+  int       sock;
+  int       i;
+
+  addrCount = pbEndpointResolve(url, addrs, POTATO_CONNECT_ADDRS);
+  for (i = 0; i < addrCount; i++) {
+
+    sock = socket(addrs[i].family, SOCK_STREAM, 0);
+    if (sock < 0)
+      continue;
+
+    if (connect(sock, (const struct sockaddr*)&addrs[i].addr, addrs[i].len) == 0)
+      return sock;
+
+    close(sock);
   }
 
-  freeaddrinfo(resOrig);
- 
+  return PB_NETWORK;
+}
+
+#endif
+
+#ifdef AF_UNIX
+
+/*
+ * Build unix domain socket address from url->path.
+ */
+static int unixAddress(const PbUrl* url, PbAddress* addr)
+{
+  struct sockaddr_un* un = (struct sockaddr_un*)&addr->addr;
+
+  if (strlen(url->path) >= sizeof(un->sun_path))
+    return PB_BADURL;
+
+  memset(addr, '\0', sizeof(PbAddress));
+  addr->family   = AF_UNIX;
+  addr->len      = sizeof(struct sockaddr_un);
+  un->sun_family = AF_UNIX;
+  strcpy(un->sun_path, url->path);
+  return PB_SUCCESS;
+}
+
+/*
+ * Connect to local broker using unix domain stream socket.
+ * Socket path is in url->path.
+ */
+static int connectUnix(const PbUrl* url)
+{
+  PbAddress addr;
+  int       sock;
+
+  if (unixAddress(url, &addr) != PB_SUCCESS)
+    return -1;
+
+  sock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (sock < 0)
+    return -1;
+
+  if (connect(sock, (const struct sockaddr*)&addr.addr, addr.len) != 0) {
+
+    close(sock);
+    return -1;
+  }
+
+  return sock;
+}
+
+#endif
+
+static void setOption(int sock, int level, int name, int value)
+{
+  setsockopt(sock, level, name, (char*)&value, sizeof(value));
+}
+
+/*
+ * Apply socket options. Options not supported by
+ * platform or socket type are silently ignored.
+ */
+static void setOptions(int sock, const PbSocketOptions* opts, bool tcp)
+{
+  if (opts->sendBuf > 0)
+    setOption(sock, SOL_SOCKET, SO_SNDBUF, opts->sendBuf);
+
+  if (opts->recvBuf > 0)
+    setOption(sock, SOL_SOCKET, SO_RCVBUF, opts->recvBuf);
+
+  if (!tcp)
+    return;
+
+  if (opts->noDelay)
+    setOption(sock, IPPROTO_TCP, TCP_NODELAY, 1);
+
+#ifdef TCP_USER_TIMEOUT
+  if (opts->userTimeout > 0)
+    setOption(sock, IPPROTO_TCP, TCP_USER_TIMEOUT, opts->userTimeout);
+#endif
+
+  if (opts->keepIdle > 0) {
+
+    setOption(sock, SOL_SOCKET, SO_KEEPALIVE, 1);
+
+#ifdef TCP_KEEPIDLE
+    setOption(sock, IPPROTO_TCP, TCP_KEEPIDLE, opts->keepIdle);
+#endif
+#ifdef TCP_KEEPINTVL
+    if (opts->keepInterval > 0)
+      setOption(sock, IPPROTO_TCP, TCP_KEEPINTVL, opts->keepInterval);
+#endif
+#ifdef TCP_KEEPCNT
+    if (opts->keepCount > 0)
+      setOption(sock, IPPROTO_TCP, TCP_KEEPCNT, opts->keepCount);
+#endif
+  }
+}
+
+/*
+ * Prepare newly connected socket for use.
+ */
+static void socketConnected(PbClient* client, bool tcp)
+{
+  client->corked = false;
+  setOptions(client->sock, &client->sockOpts, tcp);
+}
+
+static void usePlainTransport(PbClient* client)
+{
+  client->writePacket = writePlainPacket;
+  client->readPacket  = readPlainPacket;
+  client->flushPacket = flushPlainPacket;
+  client->closeConnection = closePlainConnection;
+}
+
+/*
+ * Install testing and debugging layers on top of
+ * transport. Capture sees data as impaired.
+ */
+static void attachLayers(PbClient* client)
+{
+  if (client->impair != NULL)
+    pbImpairAttach(client);
+
+  if (client->capture != NULL)
+    pbCaptureAttach(client);
+}
+
+void pbClientInit(PbClient* client)
+{
+  memset(client, '\0', sizeof(PbClient));
+  client->sock = -1;
+  pbNewPacket(&client->packet);
+  pbTimerInit(&client->keepAliveTimer, NULL, client);
+  pbTimerInit(&client->responseTimer, NULL, client);
+#if POTATO_TLS && POTATO_TLS_RESUME
+  mbedtls_ssl_session_init(&client->session);
+#endif
+}
+
+void pbSetOptions(PbClient* client, int connectTimeout, const PbSocketOptions* sockOpts)
+{
+  client->connectTimeout = connectTimeout;
+  if (sockOpts != NULL)
+    client->sockOpts = *sockOpts;
+  else
+    memset(&client->sockOpts, '\0', sizeof(PbSocketOptions));
+}
+
+int pbCork(PbClient* client, bool cork)
+{
+  int st = PB_SUCCESS;
+
   if (client->sock == -1)
     return PB_NETWORK;
 
+  client->corked = cork;
+  if (!cork && client->flushPacket(client) < 0)
+    st = PB_NETWORK;
+
+#ifdef TCP_CORK
+  if (client->sockOpts.cork)
+    setOption(client->sock, IPPROTO_TCP, TCP_CORK, cork);
+#endif
+
+  return st;
+}
+
+static int connectSocket(PbClient*            client,
+                         const PbUrl*         url,
+                         mbedtls_ssl_config*  sslConf)
+{
+  int      st;
+#if POTATO_TLS
+#if POTATO_TLS_RESUME
+  uint32_t sessionKey;
+#endif
+
+  client->sslResult = 0;
+#endif
+
+  bool tcp = true;
+  int64_t start = 0;
+
+  if (client->latency != NULL)
+    start = pbClock();
+
+#ifdef AF_UNIX
+  if (!strcmp(url->protocol, "unix")) {
+
+    tcp = false;
+    client->sock = connectUnix(url);
+  }
+  else
+#endif
+    client->sock = connectTcp(url, client->connectTimeout);
+
+  if (client->sock < 0) {
+
+    st = client->sock == PB_TIMEOUT ? PB_TIMEOUT : PB_NETWORK;
+    client->sock = -1;
+    return st;
+  }
+
+  if (client->latency != NULL) {
+
+    pbLatencySince(&client->latency->connect, start);
+    start = pbClock();
+  }
+
+  socketConnected(client, tcp);
+
 #if POTATO_TLS
   if (sslConf != NULL) {
 
@@ -195,19 +932,124 @@ int pbConnectSocket(PbClient*            client,
       return PB_MBEDTLS;
     }
 
+    client->sslInPos  = 0;
+    client->sslInLen  = 0;
+    client->sslOutLen = 0;
     mbedtls_ssl_set_bio(&client->ssl, client, sslWrite, sslRead, NULL);
 
+#if POTATO_KTLS
+    client->ktlsKeyLen = 0;
+    if (client->sockOpts.ktls)
+      mbedtls_ssl_conf_export_keys_cb(sslConf, exportKeys, client);
+#endif
+
+#if POTATO_TLS_RESUME
+    // Offer saved session if it is for the same endpoint.
+    // Server performs abbreviated handshake if it still
+    // accepts the session.
+    sessionKey = pbHash(PB_HASH_INIT, url->host, strlen(url->host));
+    sessionKey = pbHash(sessionKey, url->port, strlen(url->port));
+    if (client->sessionValid && client->sessionKey == sessionKey)
+      mbedtls_ssl_set_session(&client->ssl, &client->session);
+#endif
+
+    // Limit handshake with receive timeout and put
+    // previous timeout back afterwards.
+    struct timeval oldTmo;
+    socklen_t      tmoLen = sizeof(oldTmo);
+    bool           restore = false;
+
+    if (client->connectTimeout) {
+
+      struct timeval tmo;
+
+      restore = getsockopt(client->sock, SOL_SOCKET, SO_RCVTIMEO, (char *)&oldTmo, &tmoLen) == 0;
+      tmo.tv_sec  = client->connectTimeout / 1000;
+      tmo.tv_usec = (client->connectTimeout % 1000) * 1000;
+      setsockopt(client->sock, SOL_SOCKET, SO_RCVTIMEO, (char *)&tmo, sizeof(struct timeval));
+    }
+
+    do {
+
+      st = mbedtls_ssl_handshake(&client->ssl);
+    } while (st == MBEDTLS_ERR_SSL_WANT_READ || st == MBEDTLS_ERR_SSL_WANT_WRITE);
+
+#if POTATO_KTLS
+    // Callback is in shared config, don't let later
+    // handshakes write keys into this client.
+    if (client->sockOpts.ktls)
+      mbedtls_ssl_conf_export_keys_cb(sslConf, NULL, NULL);
+#endif
+
+    if (restore)
+      setsockopt(client->sock, SOL_SOCKET, SO_RCVTIMEO, (char *)&oldTmo, tmoLen);
+
+    if (st != 0) {
+
+      mbedtls_ssl_free(&client->ssl);
+      close(client->sock);
+      client->sslResult = st;
+#if POTATO_TLS_RESUME
+      client->sessionValid = false;
+#endif
+      return PB_MBEDTLS;
+    }
+
+    if (client->latency != NULL)
+      pbLatencySince(&client->latency->handshake, start);
+
+#if POTATO_TLS_RESUME
+    // Save session for next connection.
+    mbedtls_ssl_session_free(&client->session);
+    mbedtls_ssl_session_init(&client->session);
+    client->sessionValid = mbedtls_ssl_get_session(&client->ssl, &client->session) == 0;
+    client->sessionKey   = sessionKey;
+#endif
+
+#if POTATO_KTLS
+    if (client->sockOpts.ktls) {
+
+      st = enableKtls(client);
+      memset(client->ktlsKeys, '\0', sizeof(client->ktlsKeys));
+      if (st < 0) {
+
+        mbedtls_ssl_free(&client->ssl);
+        close(client->sock);
+        client->sock = -1;
+        return PB_NETWORK;
+      }
+
+      if (st > 0) {
+
+        // Kernel encrypts and decrypts records, socket
+        // can be used with plain read & write.
+        usePlainTransport(client);
+        client->closeConnection = closeKtlsConnection;
+        return PB_SUCCESS;
+      }
+    }
+#endif
+
+    // mbedtls context cannot be used by several tasks
+    // simultaneously, so shared socket must have kernel TLS.
+    if (client->shared) {
+
+      mbedtls_ssl_free(&client->ssl);
+      close(client->sock);
+      client->sock = -1;
+      return PB_ERROR;
+    }
+
     client->writePacket = writeSslPacket;
     client->readPacket  = readSslPacket;
+    client->flushPacket = flushSslPacket;
     client->closeConnection = closeSslConnection;
   }
   else {
 
 #endif
 
-    client->writePacket = writePlainPacket;
-    client->readPacket  = readPlainPacket;
-    client->closeConnection = closePlainConnection;
+    usePlainTransport(client);
 
 #if POTATO_TLS
   }
@@ -216,13 +1058,116 @@ int pbConnectSocket(PbClient*            client,
   return PB_SUCCESS;
 }
 
+int pbConnectSocket(PbClient*            client,
+                    const PbUrl*         url,
+                    mbedtls_ssl_config*  sslConf)
+{
+  int st;
+
+  PB_TRACE3(connect_start, client, url->host, url->port);
+#if POTATO_SHM
+  if (!strcmp(url->protocol, "shm"))
+    st = pbShmAttach(client, url);
+  else
+#endif
+    st = connectSocket(client, url, sslConf);
+
+  if (st == PB_SUCCESS)
+    attachLayers(client);
+
+  PB_TRACE2(connect_done, client, st);
+  return st;
+}
+
+int pbConnectSocketStart(PbClient* client, const PbUrl* url)
+{
+  PbAddress addr;
+  bool      done;
+  bool      tcp = true;
+
+  PB_TRACE3(connect_start, client, url->host, url->port);
+
+  // Don't leak previous connection.
+  if (client->sock != -1)
+    pbDisconnectSocket(client);
+
+#ifdef AF_UNIX
+  if (!strcmp(url->protocol, "unix")) {
+
+    if (unixAddress(url, &addr) != PB_SUCCESS)
+      return PB_BADURL;
+
+    tcp = false;
+  }
+  else
+#endif
+  if (pbEndpointResolve(url, &addr, 1) <= 0)
+    return PB_NETWORK;
+
+  // Socket stays in non-blocking mode.
+  client->sock = startConnect(&addr, &done);
+  if (client->sock == -1)
+    return PB_NETWORK;
+
+  socketConnected(client, tcp);
+  usePlainTransport(client);
+  return PB_SUCCESS;
+}
+
+int pbConnectSocketFinish(PbClient* client, PbAsync* op)
+{
+  int       err = -1;
+  socklen_t errLen = sizeof(err);
+  int       st;
+
+  st = waitSocket(client->sock, true, 0);
+  if (st == 0 || (st < 0 && errno == EINTR)) {
+
+    op->wait = PB_ASYNC_WRITE;
+    op->sock = client->sock;
+    return PB_WOULDBLOCK;
+  }
+
+  op->wait = PB_ASYNC_NONE;
+  if (st < 0 || getsockopt(client->sock, SOL_SOCKET, SO_ERROR, &err, &errLen) != 0 || err != 0) {
+
+    close(client->sock);
+    client->sock = -1;
+    PB_TRACE2(connect_done, client, PB_NETWORK);
+    return PB_NETWORK;
+  }
+
+  attachLayers(client);
+  PB_TRACE2(connect_done, client, PB_SUCCESS);
+  return PB_SUCCESS;
+}
+
 int pbDisconnectSocket(PbClient* client)
 {
+  if (client->timers != NULL) {
+
+    pbTimerCancel(client->timers, &client->keepAliveTimer);
+    pbTimerCancel(client->timers, &client->responseTimer);
+  }
+
   client->closeConnection(client);
   client->sock = -1;
+  pbFreePacket(pbRxPacket(client));
   return PB_SUCCESS;
 }
 
+void pbAbortSocket(PbClient* client)
+{
+  if (client->shared) {
+
+    shutdown(client->sock, SHUT_RDWR);
+    return;
+  }
+
+  close(client->sock);
+  client->sock = -1;
+}
+
 int pbUrlTok(PbUrl* url, char* urlString)
 {
   char* ptr;
@@ -249,6 +1194,18 @@ int pbUrlTok(PbUrl* url, char* urlString)
 
   start = start + 2;
 
+  // Unix domain socket url has only absolute path,
+  // like unix:///path/to/socket
+  if (!strcmp(url->protocol, "unix")) {
+
+    if (*start != '/')
+      return -1;
+
+    url->host = "";
+    url->path = start;
+    return 0;
+  }
+
   // Check for username/password
   ptr = strchr(start, '@');
   if (ptr != NULL) {
@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "potato-codec.h"
+
+/*
+ * LZ format is a sequence of tokens:
+ *
+ *   0xxxxxxx                  literal run of x + 1 bytes follows
+ *   1lllllhh oooooooo         match of l + 3 bytes at distance
+ *                             (hh << 8 | o) + 1 back in output
+ */
+
+#define LZ_MIN_MATCH 3
+#define LZ_MAX_MATCH (31 + LZ_MIN_MATCH)
+#define LZ_MAX_RUN   128
+#define LZ_HASH_SIZE (1 << POTATO_LZ_HASH_BITS)
+#define LZ_EMPTY     0xffff
+
+static inline int hash3(const uint8_t* p)
+{
+  uint32_t v = (p[0] << 16) | (p[1] << 8) | p[2];
+
+  return (v * 2654435761u) >> (32 - POTATO_LZ_HASH_BITS);
+}
+
+static int emitLiterals(const uint8_t* lit, int len, uint8_t* out, int outPos, int outLen)
+{
+  int run;
+
+  while (len > 0) {
+
+    run = len > LZ_MAX_RUN ? LZ_MAX_RUN : len;
+    if (outPos + 1 + run > outLen)
+      return -1;
+
+    out[outPos++] = run - 1;
+    memcpy(out + outPos, lit, run);
+    outPos += run;
+    lit += run;
+    len -= run;
+  }
+
+  return outPos;
+}
+
+int pbLzCompress(const uint8_t* in, int inLen, uint8_t* out, int outLen)
+{
+  uint16_t table[LZ_HASH_SIZE];
+  int      i = 0;
+  int      litStart = 0;
+  int      outPos = 0;
+  int      h;
+  int      cand;
+  int      len;
+  int      off;
+
+  if (inLen > LZ_EMPTY)
+    return -1;
+
+  memset(table, 0xff, sizeof(table));
+
+  while (i + LZ_MIN_MATCH <= inLen) {
+
+    h = hash3(in + i);
+    cand = table[h];
+    table[h] = i;
+
+    if (cand == LZ_EMPTY || i - cand > PB_LZ_WINDOW || memcmp(in + cand, in + i, LZ_MIN_MATCH)) {
+
+      ++i;
+      continue;
+    }
+
+    len = LZ_MIN_MATCH;
+    while (i + len < inLen && len < LZ_MAX_MATCH && in[cand + len] == in[i + len])
+      ++len;
+
+    outPos = emitLiterals(in + litStart, i - litStart, out, outPos, outLen);
+    if (outPos < 0 || outPos + 2 > outLen)
+      return -1;
+
+    off = i - cand - 1;
+    out[outPos++] = 0x80 | ((len - LZ_MIN_MATCH) << 2) | (off >> 8);
+    out[outPos++] = off & 0xff;
+
+    i += len;
+    litStart = i;
+  }
+
+  return emitLiterals(in + litStart, inLen - litStart, out, outPos, outLen);
+}
+
+static void lzDecodeInit(void* state)
+{
+  PbLzDecoder* dec = state;
+
+  dec->total    = 0;
+  dec->literals = 0;
+  dec->matchLen = 0;
+  dec->token    = -1;
+}
+
+static inline void put(PbLzDecoder* dec, uint8_t b, uint8_t* out)
+{
+  dec->window[dec->total % PB_LZ_WINDOW] = b;
+  dec->total++;
+  *out = b;
+}
+
+int pbLzDecompress(PbLzDecoder* dec, const uint8_t** in, int* inLen, uint8_t* out, int outLen)
+{
+  const uint8_t* ptr = *in;
+  const uint8_t* end = *in + *inLen;
+  int            produced = 0;
+  uint8_t        b;
+
+  while (produced < outLen) {
+
+    if (dec->matchLen > 0) {
+
+      b = dec->window[(dec->total - dec->matchOff) % PB_LZ_WINDOW];
+      put(dec, b, out + produced++);
+      dec->matchLen--;
+      continue;
+    }
+
+    if (ptr == end)
+      break;
+
+    if (dec->literals > 0) {
+
+      put(dec, *ptr++, out + produced++);
+      dec->literals--;
+      continue;
+    }
+
+    b = *ptr++;
+    if (dec->token != -1) {
+
+      // Second byte of match token.
+      dec->matchOff = (((dec->token & 3) << 8) | b) + 1;
+      dec->matchLen = ((dec->token >> 2) & 0x1f) + LZ_MIN_MATCH;
+      dec->token    = -1;
+      if ((uint32_t)dec->matchOff > dec->total)
+        return -1;
+
+      continue;
+    }
+
+    if (b & 0x80)
+      dec->token = b;
+    else
+      dec->literals = b + 1;
+  }
+
+  *inLen -= ptr - *in;
+  *in = ptr;
+  return produced;
+}
+
+static int lzDecode(void* state, const uint8_t** in, int* inLen, uint8_t* out, int outLen)
+{
+  return pbLzDecompress(state, in, inLen, out, outLen);
+}
+
+const PbCodec pbLzCodec = {
+
+  PB_CODEC_LZ,
+  pbLzCompress,
+  lzDecodeInit,
+  lzDecode
+};
+
+int pbWritePublishCodec(PbPacket* pkt, PbPublish* args, const PbCodec* codec)
+{
+  uint8_t* marker;
+  int      len;
+
+  pbInitPacket(pkt);
+
+// Write variable header.
+
+  pbWriteString(pkt, args->topic);
+
+// Write marker and payload. Use compressed data only
+// if it is smaller than original.
+
+  PB_CHECK_SPACE(pkt, 1);
+  marker = pkt->end++;
+
+  len = codec->encode(args->message, args->len, pkt->end, pbRoomLeft(pkt));
+  if (len >= 0 && len < args->len) {
+
+    *marker = codec->id;
+    pkt->end += len;
+  }
+  else {
+
+    *marker = PB_CODEC_NONE;
+    PB_CHECK_SPACE(pkt, args->len);
+    memcpy(pkt->end, args->message, args->len);
+    pkt->end += args->len;
+  }
+
+// Write header.
+
+  pbWriteHeader(pkt, PB_MQ_PUBLISH, 0, pbLength(pkt));
+
+  if (pkt->overflow)
+    return -1;
+
+  return 0;
+}
+
+void pbDecodeStart(PbDecoder* dec, const PbCodec* codec, void* state, const PbPublish* pub)
+{
+  dec->codec = NULL;
+  dec->state = state;
+  dec->in    = pub->message;
+  dec->inLen = pub->len;
+  dec->error = false;
+
+  if (dec->inLen == 0)
+    return;
+
+  dec->inLen--;
+  switch (*dec->in++) {
+  case PB_CODEC_NONE:
+    break;
+
+  default:
+    if (codec != NULL && dec->in[-1] == codec->id) {
+
+      dec->codec = codec;
+      codec->decodeInit(state);
+    }
+    else
+      dec->error = true;
+
+    break;
+  }
+}
+
+int pbDecodeNext(PbDecoder* dec, uint8_t* out, int outLen)
+{
+  int len;
+
+  if (dec->error)
+    return PB_ERROR;
+
+  if (dec->codec == NULL) {
+
+    len = dec->inLen < outLen ? dec->inLen : outLen;
+    memcpy(out, dec->in, len);
+    dec->in += len;
+    dec->inLen -= len;
+    return len;
+  }
+
+  len = dec->codec->decode(dec->state, &dec->in, &dec->inLen, out, outLen);
+  if (len < 0) {
+
+    dec->error = true;
+    return PB_ERROR;
+  }
+
+  return len;
+}
+
+int pbDecodePublish(const PbCodec* codec, void* state, const PbPublish* pub, uint8_t* out, int outLen)
+{
+  PbDecoder dec;
+  int       total = 0;
+  int       len;
+  uint8_t   extra;
+
+  pbDecodeStart(&dec, codec, state, pub);
+
+  while ((len = pbDecodeNext(&dec, out + total, outLen - total)) > 0)
+    total += len;
+
+  if (len < 0)
+    return len;
+
+  // Check if there would be more output.
+  if (total == outLen && pbDecodeNext(&dec, &extra, 1) != 0)
+    return PB_TOOBIG;
+
+  return total;
+}
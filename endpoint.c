@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef USE_UNIX_SOCKETS
+
+#include <sys/socket.h>
+#include <netdb.h>
+#include <netinet/in.h>
+
+#else
+
+#include <picoos.h>
+#include <picoos-lwip.h>
+
+#endif
+
+#include "potato-bus.h"
+#include "potato-port.h"
+
+#if POTATO_ENDPOINT_CACHE > 0
+
+#define TTL           ((int64_t)POTATO_ENDPOINT_TTL * 1000000)
+#define REFRESH_AHEAD (TTL / 4)
+
+/*
+ * Cached endpoint, keyed by host and port.
+ */
+typedef struct {
+
+  char      host[POTATO_ENDPOINT_HOST];
+  char      port[8];
+  int       count;
+  PbAddress addrs[POTATO_CONNECT_ADDRS];
+  int64_t   expires;
+  int64_t   used;
+  bool      refreshing;
+} PbEndpoint;
+
+static PbEndpoint endpoints[POTATO_ENDPOINT_CACHE];
+static PbMutex    mutex;
+static bool       mutexReady = false;
+static bool       initialized = false;
+
+static void refreshTask(void* arg);
+
+int pbEndpointInit()
+{
+  if (initialized)
+    return PB_SUCCESS;
+
+  // Mutex is kept if task creation fails, so
+  // a retry doesn't initialize it again.
+  if (!mutexReady) {
+
+    if (pbMutexInit(&mutex) != PB_SUCCESS)
+      return PB_ERROR;
+
+    mutexReady = true;
+  }
+
+  if (pbTaskCreate(refreshTask, NULL, "PbResolver") != PB_SUCCESS)
+    return PB_ERROR;
+
+  initialized = true;
+  return PB_SUCCESS;
+}
+
+static PbEndpoint* find(const char* host, const char* port)
+{
+  PbEndpoint* ep;
+
+  for (ep = endpoints; ep < endpoints + POTATO_ENDPOINT_CACHE; ep++)
+    if (ep->count > 0 && !strcmp(ep->host, host) && !strcmp(ep->port, port))
+      return ep;
+
+  return NULL;
+}
+
+/*
+ * Find unused entry or the one that has not been
+ * used for longest time.
+ */
+static PbEndpoint* allocate()
+{
+  PbEndpoint* ep;
+  PbEndpoint* oldest = endpoints;
+
+  for (ep = endpoints; ep < endpoints + POTATO_ENDPOINT_CACHE; ep++) {
+
+    if (ep->count == 0 && !ep->refreshing)
+      return ep;
+
+    if (!ep->refreshing && (oldest->refreshing || ep->used < oldest->used))
+      oldest = ep;
+  }
+
+  if (oldest->refreshing)
+    return NULL;
+
+  return oldest;
+}
+
+static int copyOut(PbEndpoint* ep, PbAddress* addrs, int max)
+{
+  int count = ep->count < max ? ep->count : max;
+
+  memcpy(addrs, ep->addrs, count * sizeof(PbAddress));
+  return count;
+}
+
+/*
+ * Resolver task. Refreshes addresses that have been used
+ * since they were last resolved and are about to expire.
+ */
+static void refreshTask(void* arg)
+{
+  PbEndpoint* ep;
+  PbAddress   addrs[POTATO_CONNECT_ADDRS];
+  char        host[POTATO_ENDPOINT_HOST];
+  char        port[8];
+  int         count;
+
+  while (true) {
+
+    pbSleep(1000);
+
+    for (ep = endpoints; ep < endpoints + POTATO_ENDPOINT_CACHE; ep++) {
+
+      pbMutexLock(&mutex);
+
+      if (ep->count == 0 ||
+          ep->expires - pbClock() > REFRESH_AHEAD ||
+          ep->used < ep->expires - TTL) {
+
+        pbMutexUnlock(&mutex);
+        continue;
+      }
+
+      strcpy(host, ep->host);
+      strcpy(port, ep->port);
+      ep->refreshing = true;
+      pbMutexUnlock(&mutex);
+
+      count = pbResolve(host, port, addrs, POTATO_CONNECT_ADDRS);
+
+      pbMutexLock(&mutex);
+
+      if (count > 0) {
+
+        ep->count = count;
+        memcpy(ep->addrs, addrs, count * sizeof(PbAddress));
+        ep->expires = pbClock() + TTL;
+      }
+
+      ep->refreshing = false;
+      pbMutexUnlock(&mutex);
+    }
+  }
+}
+
+int pbEndpointResolve(const PbUrl* url, PbAddress* addrs, int max)
+{
+  PbEndpoint* ep;
+  int64_t     now;
+  int         count;
+
+  if (strlen(url->host) >= POTATO_ENDPOINT_HOST || strlen(url->port) >= sizeof(ep->port))
+    return pbResolve(url->host, url->port, addrs, max);
+
+  if (!initialized)
+    return pbResolve(url->host, url->port, addrs, max);
+
+  now = pbClock();
+  pbMutexLock(&mutex);
+
+  ep = find(url->host, url->port);
+  if (ep != NULL) {
+
+    ep->used = now;
+    if (now < ep->expires || ep->refreshing) {
+
+      // Valid entry, or background refresh is in progress.
+      // Refresh task takes care of entries about to expire.
+      count = copyOut(ep, addrs, max);
+      pbMutexUnlock(&mutex);
+      return count;
+    }
+  }
+
+  pbMutexUnlock(&mutex);
+
+  // Not in cache or expired, resolve now.
+  count = pbResolve(url->host, url->port, addrs, max);
+
+  pbMutexLock(&mutex);
+
+  ep = find(url->host, url->port);
+  if (count <= 0) {
+
+    // Resolver failed, serve stale entry if there is one.
+    if (ep != NULL)
+      count = copyOut(ep, addrs, max);
+
+    pbMutexUnlock(&mutex);
+    return count;
+  }
+
+  if (ep == NULL)
+    ep = allocate();
+
+  if (ep != NULL && !ep->refreshing) {
+
+    strcpy(ep->host, url->host);
+    strcpy(ep->port, url->port);
+    ep->count = count < POTATO_CONNECT_ADDRS ? count : POTATO_CONNECT_ADDRS;
+    memcpy(ep->addrs, addrs, ep->count * sizeof(PbAddress));
+    ep->expires = now + TTL;
+    ep->used = now;
+  }
+
+  pbMutexUnlock(&mutex);
+  return count;
+}
+
+void pbEndpointFlush()
+{
+  PbEndpoint* ep;
+
+  if (!initialized)
+    return;
+
+  pbMutexLock(&mutex);
+
+  for (ep = endpoints; ep < endpoints + POTATO_ENDPOINT_CACHE; ep++)
+    if (!ep->refreshing)
+      ep->count = 0;
+
+  pbMutexUnlock(&mutex);
+}
+
+#else
+
+int pbEndpointInit()
+{
+  return PB_SUCCESS;
+}
+
+int pbEndpointResolve(const PbUrl* url, PbAddress* addrs, int max)
+{
+  return pbResolve(url->host, url->port, addrs, max);
+}
+
+void pbEndpointFlush()
+{
+}
+
+#endif
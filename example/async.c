@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <picoos.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "potato-bus.h"
+#include "potato-port.h"
+#include "potato-async.h"
+#include "potato-timer.h"
+
+void potatoAsyncStart(void);
+
+#define CONNS 4
+
+typedef struct {
+
+  PbAsync     co;      // state of connection coroutine
+  PbAsync     op;      // state of operation in progress
+  PbClient    client;
+  PbConnect   cd;
+  PbSubscribe sub;
+  const char* url;
+  const char* topic;
+} Conn;
+
+static PbTimerWheel wheel;
+static Conn conns[CONNS] = {
+
+  { .url = "mqtt://broker1.example.com", .topic = "sensors/storage" },
+  { .url = "mqtt://broker1.example.com", .topic = "sensors/power-meter" },
+  { .url = "mqtt://broker2.example.com", .topic = "weather/#" },
+  { .url = "mqtt://broker3.example.com", .topic = "alarms/#" }
+};
+
+static PbClient httpClient;
+static PbAsync  httpOp;
+static PbAsync  httpCo;
+
+//
+// Connection coroutine. Local variables are not preserved
+// when coroutine waits, so everything is kept in Conn.
+//
+static int connTask(Conn* c)
+{
+  int st;
+
+  PB_ASYNC_BEGIN(&c->co);
+
+  c->cd.clientId  = "test";
+  c->cd.keepAlive = 60;
+  PB_ASYNC_AWAIT(&c->co, st, pbAsyncConnect(&c->client, &c->op, c->url, &c->cd));
+  if (st < 0)
+    PB_ASYNC_EXIT(&c->co, st);
+
+  c->sub.topic = c->topic;
+  PB_ASYNC_AWAIT(&c->co, st, pbAsyncSubscribe(&c->client, &c->op, &c->sub));
+  if (st < 0)
+    PB_ASYNC_EXIT(&c->co, st);
+
+//
+// Keepalive pings are sent by pbAsyncEvent using timer wheel.
+//
+  while (true) {
+
+    PB_ASYNC_AWAIT(&c->co, st, pbAsyncEvent(&c->client, &c->op));
+    if (st < 0)
+      break;
+
+    if (st == PB_MQ_PUBLISH) {
+
+      PbPublish pub;
+
+      pbReadPublish(pbRxPacket(&c->client), &pub);
+      printf("%s: topic %s len %d\n", c->url, pub.topic, pub.len);
+    }
+  }
+
+  PB_ASYNC_END(&c->co, st);
+}
+
+//
+// Fetch a document once a minute.
+//
+static int httpTask(void)
+{
+  int st;
+
+  PB_ASYNC_BEGIN(&httpCo);
+  PB_ASYNC_AWAIT(&httpCo, st, pbAsyncGet(&httpClient, &httpOp, "http://www.example.com/status.json", NULL));
+  if (st >= 0)
+    printf("http: got %d bytes\n", st);
+
+  PB_ASYNC_END(&httpCo, st);
+}
+
+static void potatoTask(void* arg)
+{
+  PbAsync* ops[CONNS + 1];
+  int      i;
+  int      wait;
+  int64_t  nextGet = 0;
+
+  pbTimerWheelInit(&wheel);
+  for (i = 0; i < CONNS; i++) {
+
+    pbClientInit(&conns[i].client);
+    conns[i].client.timers = &wheel;
+    pbAsyncInit(&conns[i].op, 0);
+    ops[i] = &conns[i].op;
+  }
+
+  pbClientInit(&httpClient);
+  pbAsyncInit(&httpOp, 30000);
+  ops[CONNS] = &httpOp;
+
+  while (true) {
+
+//
+// Resume everything. Connections that fail are
+// started again on next round.
+//
+    for (i = 0; i < CONNS; i++)
+      if (connTask(&conns[i]) != PB_WOULDBLOCK) {
+
+        printf("potato: %s disconnected.\n", conns[i].url);
+        if (conns[i].client.sock != -1)
+          pbDisconnectSocket(&conns[i].client);
+      }
+
+    if (pbAsyncBusy(&httpCo) || pbClock() >= nextGet) {
+
+      if (!pbAsyncBusy(&httpCo))
+        nextGet = pbClock() + 60000000LL;
+
+      httpTask();
+    }
+
+//
+// Sleep until some socket is ready or a timer expires.
+//
+    wait = pbTimerWheelNext(&wheel);
+    if (wait < 0 || wait > 1000)
+      wait = 1000;
+
+    pbAsyncWait(ops, CONNS + 1, wait);
+  }
+}
+
+void potatoAsyncStart()
+{
+  pbEndpointInit();
+  nosTaskCreate(potatoTask, NULL, 2, 4000, "PotatoAsync");
+}
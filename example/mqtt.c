@@ -36,6 +36,7 @@
 #include <string.h>
 
 #include "potato-bus.h"
+#include "potato-port.h"
 
 void potatoStart(void);
 
@@ -44,6 +45,7 @@ static bool sendData = false;
 
 static void potatoTask(void* arg)
 {
+  pbClientInit(&client);
   while (true) {
 
 //
@@ -137,5 +139,6 @@ static void potatoTask(void* arg)
 
 void potatoStart()
 {
+  pbEndpointInit();
   nosTaskCreate(potatoTask, NULL, 2, 4000, "PotatoBus");
 }
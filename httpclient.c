@@ -49,10 +49,73 @@
 #endif
 
 #include "potato-bus.h"
+#include "potato-trace.h"
+#include "potato-async.h"
 
-int pbGet(PbClient*            client,
-          const char*          url,
-          mbedtls_ssl_config*  sslConf)
+#define HTTP_FIRST 1    // next header line is status line
+#define HTTP_SKIP  2    // dropping header line that didn't fit into buffer
+
+/*
+ * Parse one header line. Content-Length is limited
+ * to packet buffer size.
+ */
+static int parseHeader(char* hdr, bool first, int* contentLength)
+{
+  char* ptr;
+  int   httpCode;
+
+  if (first) {
+
+    ptr = strchr(hdr, ' ');
+    if (ptr == NULL)
+      return PB_HTTP;
+
+    *ptr = '\0';
+    if (strcmp(hdr, "HTTP/1.1") && strcmp(hdr, "HTTP/1.0"))
+      return PB_HTTP;
+
+    ++ptr;
+    while (*ptr == ' ')
+      ++ptr;
+
+    httpCode = strtol(ptr, NULL, 10);
+    if (httpCode != 200)
+      return -httpCode;
+
+    return PB_SUCCESS;
+  }
+
+  ptr = strchr(hdr, ':');
+  if (ptr != NULL) {
+
+    *ptr = '\0';
+    if (!strcasecmp(hdr, "Content-Length")) {
+
+      ++ptr;
+      while (*ptr == ' ')
+        ++ptr;
+
+      *contentLength = strtol(ptr, NULL, 10);
+      if (*contentLength > POTATO_BUFSIZE - 1)
+        *contentLength = POTATO_BUFSIZE - 1;
+    }
+  }
+
+  return PB_SUCCESS;
+}
+
+int pbGet(PbClient*              client,
+          const char*            url,
+          mbedtls_ssl_config*    sslConf)
+{
+  return pbGetEx(client, url, sslConf, 0, NULL);
+}
+
+int pbGetEx(PbClient*              client,
+            const char*            url,
+            mbedtls_ssl_config*    sslConf,
+            int                    connectTimeout,
+            const PbSocketOptions* sockOpts)
 {
   bool  ssl;
   PbUrl urlParts;
@@ -67,6 +130,7 @@ int pbGet(PbClient*            client,
   if (pbUrlTok(&urlParts, (char*)pkt->start) == -1)
     return PB_BADURL;
 
+  pbSetOptions(client, connectTimeout, sockOpts);
   if (!strcmp(urlParts.protocol, "http")) {
 
     ssl = false;
@@ -99,9 +163,12 @@ int pbGet(PbClient*            client,
 
   setsockopt(client->sock, SOL_SOCKET, SO_RCVTIMEO, (char *)&tmo, sizeof(struct timeval));
 
-  if (client->writePacket(client, (uint8_t*)"GET /", 5) == -1 ||
-      client->writePacket(client, (uint8_t*)urlParts.path, strlen(urlParts.path)) == -1 ||
-      client->writePacket(client, (uint8_t*)" HTTP/1.0\r\n\r\n", 13) == -1) {
+  pbCork(client, true);
+
+  if (client->writePacket(client, (uint8_t*)"GET /", 5) < 0 ||
+      client->writePacket(client, (uint8_t*)urlParts.path, strlen(urlParts.path)) < 0 ||
+      client->writePacket(client, (uint8_t*)" HTTP/1.0\r\n\r\n", 13) < 0 ||
+      pbCork(client, false) < 0) {
 
     pbDisconnectSocket(client);
     return PB_NETWORK;
@@ -113,6 +180,8 @@ int pbGet(PbClient*            client,
 
   st = PB_SUCCESS;
 
+  PB_TRACE1(http_header_start, client);
+
   // Loop through headers.
   do {
 
@@ -134,61 +203,16 @@ int pbGet(PbClient*            client,
     pbWriteByte(pkt, '\0');
 
     if (!pkt->overflow && pbLength(pkt) > 1) {
-   
-      char* hdr = (char*)pkt->start;
-      char* ptr;
-      int   httpCode;
-
-      if (first) {
-
-        first = false;
-        ptr = strchr(hdr, ' ');
-        if (ptr == NULL) {
-
-          st = PB_HTTP;
-          break;
-        }
-
-        *ptr = '\0';
-        if (strcmp(hdr, "HTTP/1.1") && strcmp(hdr, "HTTP/1.0")) {
 
-          st = PB_HTTP;
-          break;
-        }
-
-        ++ptr;
-        while (*ptr == ' ')
-          ++ptr;
-
-        httpCode = strtol(ptr, NULL, 10);
-        if (httpCode != 200) {
-
-          st = -httpCode;
-          break;
-        }
-      }
-      else {
-
-        ptr = strchr(hdr, ':');
-        if (ptr != NULL) {
-  
-          *ptr = '\0';
-           if (!strcasecmp(hdr, "Content-Length")) {
-
-             ++ptr;
-             while (*ptr == ' ')
-               ++ptr;
-
-             contentLength = strtol(ptr, NULL, 10);
-             if (contentLength > POTATO_BUFSIZE - 1)
-               contentLength = POTATO_BUFSIZE - 1;
-           }
-        }
-      }
+      st = parseHeader((char*)pkt->start, first, &contentLength);
+      first = false;
+      if (st != PB_SUCCESS)
+        break;
     }
 
   } while (pbLength(pkt) > 1);
 
+  PB_TRACE2(http_header_done, client, st);
   pbInitPacket(pkt);
 
   if (st == PB_SUCCESS) {
@@ -205,9 +229,157 @@ int pbGet(PbClient*            client,
     }
 
     st = pbLength(pkt);
+    PB_TRACE2(http_body_done, client, st);
   }
 
   pbDisconnectSocket(client);
   return st;
 }
 
+
+/*
+ * Space for body data: up to content length, leaving
+ * room for null character.
+ */
+static int bodyRoom(PbPacket* pkt, int contentLength)
+{
+  int room = pbRoomLeft(pkt) - 1;
+
+  if (contentLength - pbLength(pkt) < room)
+    room = contentLength - pbLength(pkt);
+
+  return room;
+}
+
+int pbAsyncGet(PbClient*              client,
+               PbAsync*               op,
+               const char*            url,
+               const PbSocketOptions* sockOpts)
+{
+  PbUrl     urlParts;
+  PbPacket* pkt = &client->packet;
+  uint8_t*  eol;
+  bool      last;
+  int       len;
+  int       st = PB_ERROR;
+
+  if (pbAsyncCheck(client, op) < 0)
+    return PB_TIMEOUT;
+
+  PB_ASYNC_BEGIN(op);
+
+  pbInitPacket(pkt);
+  if (!pbHasRoom(pkt, strlen(url) + 1))
+    PB_ASYNC_EXIT(op, PB_BADURL);
+
+  strcpy((char*)pkt->start, url);
+  if (pbUrlTok(&urlParts, (char*)pkt->start) == -1 || strcmp(urlParts.protocol, "http"))
+    PB_ASYNC_EXIT(op, PB_BADURL);
+
+  if (urlParts.port == NULL)
+    urlParts.port = "80";
+
+  // Operation timeout limits connect too.
+  pbSetOptions(client, 0, sockOpts);
+  len = strlen(urlParts.path);
+  if (!pbHasRoom(pkt, len + 18))
+    PB_ASYNC_EXIT(op, PB_BADURL);
+
+  st = pbConnectSocketStart(client, &urlParts);
+  if (st < 0)
+    PB_ASYNC_EXIT(op, st);
+
+  // Build request in place. Path is after host name
+  // in buffer, so it can be moved to front.
+  memmove(pkt->start + 5, urlParts.path, len);
+  memcpy(pkt->start, "GET /", 5);
+  memcpy(pkt->start + 5 + len, " HTTP/1.0\r\n\r\n", 13);
+  pkt->end = pkt->start + 5 + len + 13;
+
+  PB_ASYNC_AWAIT(op, st, pbConnectSocketFinish(client, op));
+  if (st < 0)
+    PB_ASYNC_EXIT(op, st);
+
+  PB_ASYNC_AWAIT(op, st, pbAsyncWrite(client, op, pkt->start, pbLength(pkt)));
+  if (st < 0) {
+
+    pbDisconnectSocket(client);
+    PB_ASYNC_EXIT(op, PB_NETWORK);
+  }
+
+  PB_TRACE1(http_header_start, client);
+  pbInitPacket(pkt);
+  op->flags = HTTP_FIRST;
+  op->len   = POTATO_BUFSIZE - 1;
+
+  // Collect header lines. Data after empty line
+  // is start of body.
+  while (true) {
+
+    eol = memchr(pkt->start, '\n', pbLength(pkt));
+    if (eol == NULL) {
+
+      if (pbRoomLeft(pkt) <= 1) {
+
+        op->flags |= HTTP_SKIP;
+        pbInitPacket(pkt);
+      }
+
+      PB_ASYNC_AWAIT(op, st, pbAsyncRead(client, op, pkt->end, pbRoomLeft(pkt) - 1));
+      if (st <= 0) {
+
+        st = PB_NETWORK;
+        break;
+      }
+
+      pkt->end += st;
+      continue;
+    }
+
+    *eol = '\0';
+    if (eol > pkt->start && eol[-1] == '\r')
+      eol[-1] = '\0';
+
+    st   = PB_SUCCESS;
+    last = false;
+    if (op->flags & HTTP_SKIP)
+      op->flags &= ~HTTP_SKIP;
+    else if (pkt->start[0] == '\0')
+      last = true;
+    else {
+
+      st = parseHeader((char*)pkt->start, op->flags & HTTP_FIRST, &op->len);
+      op->flags &= ~HTTP_FIRST;
+    }
+
+    len = pkt->end - (eol + 1);
+    memmove(pkt->start, eol + 1, len);
+    pkt->end = pkt->start + len;
+    if (last || st != PB_SUCCESS)
+      break;
+  }
+
+  PB_TRACE2(http_header_done, client, st);
+  if (st != PB_SUCCESS) {
+
+    pbDisconnectSocket(client);
+    PB_ASYNC_EXIT(op, st);
+  }
+
+  if (pbLength(pkt) > op->len)
+    pkt->end = pkt->start + op->len;
+
+  while (bodyRoom(pkt, op->len) > 0) {
+
+    PB_ASYNC_AWAIT(op, st, pbAsyncRead(client, op, pkt->end, bodyRoom(pkt, op->len)));
+    if (st <= 0)
+      break;
+
+    pkt->end += st;
+  }
+
+  st = pbLength(pkt);
+  PB_TRACE2(http_body_done, client, st);
+  pbDisconnectSocket(client);
+  PB_ASYNC_END(op, st);
+}
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef USE_UNIX_SOCKETS
+
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#else
+
+#include <picoos.h>
+#include <picoos-lwip.h>
+
+#endif
+
+#include "potato-impair.h"
+#include "potato-port.h"
+
+static uint32_t nextRandom(PbImpair* imp)
+{
+  uint32_t x = imp->seed ? imp->seed : 2463534242u;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  imp->seed = x;
+  return x;
+}
+
+/*
+ * Accumulate delay and sleep it in whole
+ * milliseconds, so that small transfers
+ * are paced correctly on average.
+ */
+static void delay(PbImpair* imp, int64_t us)
+{
+  imp->debt += us;
+  if (imp->debt >= 1000) {
+
+    pbSleep(imp->debt / 1000);
+    imp->debt %= 1000;
+  }
+}
+
+/*
+ * Account transferred bytes. Returns false if
+ * connection should be dropped.
+ */
+static bool transfer(PbClient* client, int len)
+{
+  PbImpair* imp = client->impair;
+
+  imp->bytes += len;
+  if (imp->disconnectAfter > 0 && imp->bytes >= imp->disconnectAfter) {
+
+    shutdown(client->sock, SHUT_RDWR);
+    return false;
+  }
+
+  if (imp->bandwidth > 0)
+    delay(imp, (int64_t)len * 1000000 / imp->bandwidth);
+
+  if (imp->stallEvery > 0) {
+
+    imp->stallBytes += len;
+    if (imp->stallBytes >= imp->stallEvery) {
+
+      imp->stallBytes = 0;
+      imp->stallLeft  = imp->stallTime;
+    }
+  }
+
+  return true;
+}
+
+static int receiveTimeout(PbClient* client)
+{
+  struct timeval tmo;
+  socklen_t      len = sizeof(tmo);
+
+  if (getsockopt(client->sock, SOL_SOCKET, SO_RCVTIMEO, (char*)&tmo, &len) == -1)
+    return 0;
+
+  return tmo.tv_sec * 1000 + tmo.tv_usec / 1000;
+}
+
+/*
+ * Wait out pending stall. If stall is longer than socket
+ * receive timeout, reader sees a timeout instead.
+ */
+static bool stall(PbClient* client, bool reading)
+{
+  PbImpair* imp = client->impair;
+  int       tmo;
+
+  if (imp->stallLeft <= 0)
+    return true;
+
+  tmo = reading ? receiveTimeout(client) : 0;
+  if (tmo > 0 && imp->stallLeft > tmo) {
+
+    pbSleep(tmo);
+    imp->stallLeft -= tmo;
+    return false;
+  }
+
+  pbSleep(imp->stallLeft);
+  imp->stallLeft = 0;
+  return true;
+}
+
+static int impairWrite(PbClient* client, const unsigned char* buf, size_t len)
+{
+  PbImpair* imp = client->impair;
+  int64_t   us;
+
+  if (imp->disconnectAfter > 0 && imp->bytes >= imp->disconnectAfter)
+    return -1;
+
+  us = (int64_t)imp->latency * 1000;
+  if (imp->jitter > 0)
+    us += (int64_t)(nextRandom(imp) % (imp->jitter * 1000));
+
+  delay(imp, us);
+  stall(client, false);
+  if (!transfer(client, len))
+    return -1;
+
+  return imp->writePacket(client, buf, len);
+}
+
+static int impairRead(PbClient* client, unsigned char* buf, size_t len)
+{
+  PbImpair* imp = client->impair;
+  int       st;
+
+  if (imp->disconnectAfter > 0 && imp->bytes >= imp->disconnectAfter)
+    return -1;
+
+  if (!stall(client, true))
+    return -1;
+
+  if (imp->maxRead > 0 && len > (size_t)imp->maxRead)
+    len = imp->maxRead;
+
+  st = imp->readPacket(client, buf, len);
+  if (st > 0 && !transfer(client, st))
+    return -1;
+
+  return st;
+}
+
+void pbImpairAttach(PbClient* client)
+{
+  PbImpair* imp = client->impair;
+
+  if (client->readPacket == impairRead)
+    return;
+
+  imp->bytes       = 0;
+  imp->stallBytes  = 0;
+  imp->stallLeft   = 0;
+  imp->debt        = 0;
+  imp->writePacket = client->writePacket;
+  imp->readPacket  = client->readPacket;
+
+  client->writePacket = impairWrite;
+  client->readPacket  = impairRead;
+}
@@ -36,6 +36,7 @@
 #include <stdarg.h>
 
 #include "potato-json.h"
+#include "potato-trace.h"
 
 static JsonNode* deeper(JsonNode* parent)
 {
@@ -161,6 +162,8 @@ JsonNode* jsonParse(JsonContext* ctx, char* json)
 {
   JsonNode* root;
 
+  PB_TRACE2(json_parse_start, ctx, json);
+  ctx->error = false;
   ctx->keyEnd = NULL;
   ctx->valueEnd = NULL;
 
@@ -181,6 +184,7 @@ JsonNode* jsonParse(JsonContext* ctx, char* json)
     root->key = NULL;
     root->len = strlen(json);
 
+    PB_TRACE2(json_parse_done, ctx, root);
     return root;
   }
 
@@ -197,9 +201,11 @@ JsonNode* jsonParse(JsonContext* ctx, char* json)
     root->key = NULL;
     root->len = strlen(json);
 
+    PB_TRACE2(json_parse_done, ctx, root);
     return root;
   }
 
+  PB_TRACE2(json_parse_done, ctx, NULL);
   return NULL;
 }
 
@@ -212,7 +218,14 @@ static int scanFor(JsonNode* node, int forCh)
 
   do {
 
+    // Input ended before closing bracket.
     len = jsonScan(&node->pos, &str);
+    if (len <= 0) {
+
+      node->context->error = true;
+      break;
+    }
+
     if (len == 1 && *str == '{')
       len += scanFor(node, '}');
     else if (len == 1 && *str == '[')
@@ -251,6 +264,17 @@ void jsonReset(JsonNode* node)
   node->pos = node->base;
 }
 
+/*
+ * Stop iteration on malformed input. Parser position
+ * is moved to end so that further calls return NULL too.
+ */
+static JsonNode* malformed(JsonNode* parent)
+{
+  parent->context->error = true;
+  parent->pos = parent->base + parent->len;
+  return NULL;
+}
+
 JsonNode* jsonNext(JsonNode* parent)
 {
   JsonNode* node;
@@ -277,23 +301,29 @@ JsonNode* jsonNext(JsonNode* parent)
     if (len == 1 && *str == '}')
       return NULL;
 
-    if (*str != '"')
-      return NULL;
+    if (len < 2 || *str != '"')
+      return malformed(parent);
 
     node->key = str + 1;
     node->keyLen = len - 2;
 
     len = jsonScan(&parent->pos, &str);
-    if (len != 1 && *str != ':')
-      return NULL;
+    if (len != 1 || *str != ':')
+      return malformed(parent);
    
     len = jsonScan(&parent->pos, &str);
+    if (len <= 0)
+      return malformed(parent);
+
     node->base = str;
     node->pos  = str;
 
     if (len == 1 && *str == '{') {
 
       node->len = scanFor(parent, '}');
+      if (parent->context->error)
+        return NULL;
+
       node->token = JsonObject;
       nullTerminate(node);
       return node;
@@ -302,6 +332,9 @@ JsonNode* jsonNext(JsonNode* parent)
     if (len == 1 && *str == '[') {
 
       node->len = scanFor(parent, ']');
+      if (parent->context->error)
+        return NULL;
+
       node->token = JsonArray;
       nullTerminate(node);
       return node;
@@ -327,12 +360,18 @@ JsonNode* jsonNext(JsonNode* parent)
     if (len == 1 && *str == ']')
       return NULL;
 
+    if (len <= 0)
+      return malformed(parent);
+
     node->base = str;
     node->pos  = str;
 
     if (len == 1 && *str == '{') {
 
       node->len = scanFor(parent, '}');
+      if (parent->context->error)
+        return NULL;
+
       node->token = JsonObject;
       nullTerminate(node);
       return node;
@@ -341,6 +380,9 @@ JsonNode* jsonNext(JsonNode* parent)
     if (len == 1 && *str == '[') {
 
       node->len = scanFor(parent, ']');
+      if (parent->context->error)
+        return NULL;
+
       node->token = JsonArray;
       nullTerminate(node);
       return node;
@@ -361,12 +403,11 @@ JsonNode* jsonFind(JsonNode* parent, const char* key)
 
   parent->pos = parent->base;
 
-  do {
+  while ((n = jsonNext(parent)) != NULL) {
 
-    n = jsonNext(parent);
     if (n->keyLen && n->keyLen == strlen(key) && n->key != NULL && !strncmp(n->key, key, n->keyLen))
       return n;
-  } while (n);
+  }
 
   return NULL;
 }
@@ -427,8 +468,9 @@ static int append(JsonContext* ctx, const char* fmt, ...)
       return -1;
     }
 
+    // left excludes space reserved for terminating null.
     va_start(ap, fmt);
-    len = vsnprintf(ctx->pos, ctx->left, fmt, ap);
+    len = vsnprintf(ctx->pos, ctx->left + 1, fmt, ap);
     va_end(ap);
 
     if (len > ctx->left) {
@@ -491,6 +533,12 @@ JsonNode* jsonStartObject(JsonNode* node)
   }
   else {
 
+    // Close previous sibling and separate from it.
+    endCheck(node);
+    if (node->values > 0)
+      if (append(ctx, ",") == -1)
+        return NULL;
+
     node->values++;
     out = deeper(node);
     if (out == NULL)
@@ -520,6 +568,12 @@ JsonNode* jsonStartArray(JsonNode* node)
   }
   else {
 
+    // Close previous sibling and separate from it.
+    endCheck(node);
+    if (node->values > 0)
+      if (append(ctx, ",") == -1)
+        return NULL;
+
     node->values++;
     out = deeper(node);
     if (out == NULL)
@@ -580,6 +634,22 @@ void jsonWriteInteger(JsonNode* node, int value)
     return;
 }
 
+void jsonWriteUnsigned(JsonNode* node, unsigned int value)
+{
+  JsonContext* ctx;
+
+  ctx = node->context;
+  endCheck(node);
+
+  if (node->values > 0)
+    if (append(ctx, ",") == -1)
+      return;
+
+  node->values++;
+  if (append(ctx, "%u", value) == -1)
+    return;
+}
+
 void jsonWriteDouble(JsonNode* node, double value)
 {
   JsonContext* ctx;
@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "potato-latency.h"
+#include "potato-port.h"
+
+static int bucketOf(uint32_t value)
+{
+  int msb;
+  int shift;
+
+  if (value < PB_HIST_SUB)
+    return value;
+
+  msb   = 31 - __builtin_clz(value);
+  shift = msb - POTATO_HIST_SUB_BITS;
+  return (shift + 1) * PB_HIST_SUB + ((value >> shift) & (PB_HIST_SUB - 1));
+}
+
+static uint64_t bucketBase(int bucket)
+{
+  int shift;
+
+  if (bucket < PB_HIST_SUB)
+    return bucket;
+
+  shift = bucket / PB_HIST_SUB - 1;
+  return (uint64_t)(PB_HIST_SUB + bucket % PB_HIST_SUB) << shift;
+}
+
+void pbHistogramReset(PbHistogram* hist)
+{
+  uint32_t seq = hist->seq;
+
+  hist->seq = seq + 1;
+  __sync_synchronize();
+
+  hist->count = 0;
+  hist->min   = UINT32_MAX;
+  hist->max   = 0;
+  hist->sum   = 0;
+  memset(hist->buckets, '\0', sizeof(hist->buckets));
+
+  __sync_synchronize();
+  hist->seq = seq + 2;
+}
+
+void pbHistogramRecord(PbHistogram* hist, uint32_t value)
+{
+  uint32_t seq = hist->seq;
+
+  // Odd sequence tells readers that update is in progress.
+  hist->seq = seq + 1;
+  __sync_synchronize();
+
+  if (hist->count == 0 || value < hist->min)
+    hist->min = value;
+
+  if (value > hist->max)
+    hist->max = value;
+
+  ++hist->count;
+  hist->sum += value;
+  ++hist->buckets[bucketOf(value)];
+
+  __sync_synchronize();
+  hist->seq = seq + 2;
+}
+
+void pbHistogramSnapshot(const PbHistogram* hist, PbHistogram* snap)
+{
+  uint32_t seq;
+
+  do {
+
+    seq = hist->seq;
+    __sync_synchronize();
+
+    memcpy(snap, (const void*)hist, sizeof(PbHistogram));
+
+    __sync_synchronize();
+  } while ((seq & 1) || seq != hist->seq);
+}
+
+void pbHistogramMerge(PbHistogram* dst, const PbHistogram* src)
+{
+  uint32_t seq = dst->seq;
+  int      i;
+
+  if (src->count == 0)
+    return;
+
+  dst->seq = seq + 1;
+  __sync_synchronize();
+
+  if (dst->count == 0 || src->min < dst->min)
+    dst->min = src->min;
+
+  if (src->max > dst->max)
+    dst->max = src->max;
+
+  dst->count += src->count;
+  dst->sum   += src->sum;
+  for (i = 0; i < PB_HIST_BUCKETS; i++)
+    dst->buckets[i] += src->buckets[i];
+
+  __sync_synchronize();
+  dst->seq = seq + 2;
+}
+
+uint32_t pbHistogramPercentile(const PbHistogram* hist, double percentile)
+{
+  uint64_t rank;
+  uint64_t seen = 0;
+  uint64_t upper;
+  int      i;
+
+  if (hist->count == 0)
+    return 0;
+
+  rank = (uint64_t)(percentile / 100.0 * hist->count + 0.999999);
+  if (rank < 1)
+    rank = 1;
+
+  for (i = 0; i < PB_HIST_BUCKETS; i++) {
+
+    seen += hist->buckets[i];
+    if (seen >= rank) {
+
+      upper = bucketBase(i + 1) - 1;
+      if (upper > hist->max)
+        upper = hist->max;
+
+      if (upper < hist->min)
+        upper = hist->min;
+
+      return upper;
+    }
+  }
+
+  return hist->max;
+}
+
+uint32_t pbHistogramMean(const PbHistogram* hist)
+{
+  if (hist->count == 0)
+    return 0;
+
+  return hist->sum / hist->count;
+}
+
+void pbLatencyReset(PbLatency* lat)
+{
+  pbHistogramReset(&lat->connect);
+  pbHistogramReset(&lat->handshake);
+  pbHistogramReset(&lat->connack);
+  pbHistogramReset(&lat->ping);
+  pbHistogramReset(&lat->ack);
+  pbHistogramReset(&lat->write);
+
+  lat->connackSent = 0;
+  lat->pingSent    = 0;
+  lat->ackSent     = 0;
+}
+
+void pbLatencySince(PbHistogram* hist, int64_t start)
+{
+  int64_t elapsed = pbClock() - start;
+
+  if (elapsed < 0)
+    elapsed = 0;
+  else if (elapsed > UINT32_MAX)
+    elapsed = UINT32_MAX;
+
+  pbHistogramRecord(hist, (uint32_t)elapsed);
+}
+
+void pbLatencySent(PbLatency* lat, int type)
+{
+  switch (type) {
+    case PB_MQ_CONNECT:
+      lat->connackSent = pbClock();
+      break;
+
+    case PB_MQ_PINGREQ:
+      lat->pingSent = pbClock();
+      break;
+
+    case PB_MQ_SUBSCRIBE:
+    case PB_MQ_UNSUBSCRIBE:
+      lat->ackSent = pbClock();
+      break;
+  }
+}
+
+void pbLatencyReceived(PbLatency* lat, int type)
+{
+  int64_t* sent;
+  PbHistogram* hist;
+
+  switch (type) {
+    case PB_MQ_CONNACK:
+      sent = &lat->connackSent;
+      hist = &lat->connack;
+      break;
+
+    case PB_MQ_PINGRESP:
+      sent = &lat->pingSent;
+      hist = &lat->ping;
+      break;
+
+    case PB_MQ_SUBACK:
+    case PB_MQ_UNSUBACK:
+      sent = &lat->ackSent;
+      hist = &lat->ack;
+      break;
+
+    default:
+      return;
+  }
+
+  // Ignore responses without request.
+  if (*sent == 0)
+    return;
+
+  pbLatencySince(hist, *sent);
+  *sent = 0;
+}
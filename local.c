@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "potato-local.h"
+
+int pbLocalInit(PbLocalBus* bus, int forward)
+{
+  memset(bus, '\0', sizeof(PbLocalBus));
+  if (pbMutexInit(&bus->mutex) != PB_SUCCESS)
+    return PB_ERROR;
+
+  bus->forward = forward;
+  return PB_SUCCESS;
+}
+
+int pbLocalSubscribe(PbLocalBus* bus, const char* filter, PbLocalHandler handler, void* ctx)
+{
+  PbLocalSub* sub;
+  int         i;
+
+  pbMutexLock(&bus->mutex);
+
+  // Reuse free slot if there is one.
+  for (i = 0; i < bus->count; i++)
+    if (bus->subs[i].filter == NULL)
+      break;
+
+  if (i == POTATO_LOCAL_SUBS) {
+
+    pbMutexUnlock(&bus->mutex);
+    return PB_ERROR;
+  }
+
+  sub = &bus->subs[i];
+  sub->handler = handler;
+  sub->ctx     = ctx;
+  sub->filter  = filter;
+  if (i == bus->count)
+    ++bus->count;
+
+  pbMutexUnlock(&bus->mutex);
+  return PB_SUCCESS;
+}
+
+int pbLocalUnsubscribe(PbLocalBus* bus, const char* filter, PbLocalHandler handler, void* ctx)
+{
+  PbLocalSub* sub;
+  int         i;
+  int         st = PB_ERROR;
+
+  pbMutexLock(&bus->mutex);
+
+  for (i = 0; i < bus->count; i++) {
+
+    sub = &bus->subs[i];
+    if (sub->filter != NULL && sub->handler == handler && sub->ctx == ctx && !strcmp(sub->filter, filter)) {
+
+      sub->filter = NULL;
+      st = PB_SUCCESS;
+      break;
+    }
+  }
+
+  // Trim free slots from end, so that publish scans less.
+  while (bus->count > 0 && bus->subs[bus->count - 1].filter == NULL)
+    --bus->count;
+
+  pbMutexUnlock(&bus->mutex);
+  return st;
+}
+
+int pbLocalPublish(PbLocalBus* bus, const PbPublish* pub)
+{
+  PbLocalSub* sub;
+  int         count = 0;
+  int         i;
+
+  pbMutexLock(&bus->mutex);
+
+  ++bus->published;
+
+  // Count is re-read on each round as handler may subscribe.
+  for (i = 0; i < bus->count; i++) {
+
+    sub = &bus->subs[i];
+    if (sub->filter != NULL && pbTopicMatch(sub->filter, pub->topic)) {
+
+      sub->handler(sub->ctx, pub);
+      ++count;
+    }
+  }
+
+  bus->delivered += count;
+
+  pbMutexUnlock(&bus->mutex);
+  return count;
+}
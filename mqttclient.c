@@ -48,6 +48,16 @@
 #endif
 
 #include "potato-bus.h"
+#include "potato-pool.h"
+#include "potato-codec.h"
+#include "potato-latency.h"
+#include "potato-local.h"
+#include "potato-stats.h"
+#include "potato-record.h"
+#include "potato-shm.h"
+#include "potato-timer.h"
+#include "potato-trace.h"
+#include "potato-async.h"
 
 #define MAX_PACKET_ID 65535 
 int pbGetPacketId(PbClient *c)
@@ -59,36 +69,207 @@ int pbGetPacketId(PbClient *c)
   return c->packetId;
 }
 
+static int packetOverflow(PbClient* client)
+{
+  if (client->stats != NULL)
+    client->stats->tooBig++;
+
+  if (client->recorder != NULL)
+    pbRecordError(client->recorder, PB_TOOBIG);
+
+  return PB_TOOBIG;
+}
+
+static void writeFailed(PbClient* client, PbPacket* pkt, int len)
+{
+  PB_TRACE4(write_done, client, pkt->start[0] >> 4, len, PB_NETWORK);
+  pbAbortSocket(client);
+  if (client->recorder != NULL)
+    pbRecordError(client->recorder, PB_NETWORK);
+}
+
+/*
+ * Bookkeeping after packet has been completely written.
+ */
+static void packetWritten(PbClient* client, PbPacket* pkt, int len)
+{
+  PB_TRACE4(write_done, client, pkt->start[0] >> 4, len, len);
+  if (client->timers != NULL && client->keepAlive > 0)
+    pbTimerStart(client->timers, &client->keepAliveTimer, client->keepAlive);
+
+  if (client->latency != NULL)
+    pbLatencySent(client->latency, pkt->start[0] >> 4);
+
+  if (client->stats != NULL)
+    pbStatsPacket(client->stats, true, pkt->start, len);
+
+  if (client->recorder != NULL)
+    pbRecordPacket(client->recorder, PB_RECORD_TX, pkt->start, len);
+}
+
 int pbWritePacket(PbClient* client, PbPacket* pkt)
 {
   if (pkt->overflow)
-    return PB_TOOBIG;
+    return packetOverflow(client);
+
+  int len = pbLength(pkt);
+  int64_t start = 0;
+
+  if (client->latency != NULL)
+    start = pbClock();
+
+  PB_TRACE3(write_start, client, pkt->start[0] >> 4, len);
+  if (client->writePacket(client, pkt->start, len) != len ||
+      (!client->corked && client->flushPacket(client) < 0)) {
+
+    writeFailed(client, pkt, len);
+    return PB_NETWORK;
+  }
+
+  if (client->latency != NULL)
+    pbLatencySince(&client->latency->write, start);
+
+  packetWritten(client, pkt, len);
+  return len;
+}
+
+int pbWritePacketAsync(PbClient* client, PbPacket* pkt, PbAsync* op)
+{
+  int st;
+
+  if (pkt->overflow)
+    return packetOverflow(client);
 
   int len = pbLength(pkt);
-  if (client->writePacket(client, pkt->start, len) != len) {
 
-    close(client->sock);
-    client->sock = -1;
+  if (op->pos == 0) {
+
+    PB_TRACE3(write_start, client, pkt->start[0] >> 4, len);
+  }
+
+  st = pbAsyncWrite(client, op, pkt->start, len);
+  if (st == PB_WOULDBLOCK)
+    return st;
+
+  if (st < 0 || (!client->corked && client->flushPacket(client) < 0)) {
+
+    writeFailed(client, pkt, len);
     return PB_NETWORK;
   }
 
+  packetWritten(client, pkt, len);
   return len;
 }
 
+PbPacket* pbRxPacket(PbClient* client)
+{
+  if (client->lease != NULL)
+    return &client->lease->packet;
+
+  return &client->packet;
+}
+
+/*
+ * Prepare receive buffer for next packet.
+ */
+static PbPacket* startRead(PbClient* client)
+{
+  PbPacket* pkt;
+
+  // In lease mode, read into pooled buffer. If pool
+  // is exhausted, use client packet buffer.
+  if (client->pool != NULL && client->lease == NULL)
+    client->lease = pbPoolGet(client->pool);
+
+  pkt = pbRxPacket(client);
+
+  // Shrink back to fixed buffer after large packet.
+  pbFreePacket(pkt);
+
+  pkt->start    = pkt->buf;
+  pkt->overflow = false;
+  return pkt;
+}
+
+/*
+ * Make room for packet body of len bytes after hdrLen
+ * bytes of header. If body doesn't fit into fixed buffer,
+ * packet is moved to allocated buffer.
+ */
+static int reserveBody(PbClient* client, PbPacket* pkt, int hdrLen, int len)
+{
+  // reserve 1 extra byte at end of message, so
+  // it is possible to tack null character at
+  // end of payload - just to be C-string friendly.
+  if (hdrLen + len + 1 <= POTATO_BUFSIZE)
+    return PB_SUCCESS;
+
+  if (client->allocator == NULL || hdrLen + len + 1 > client->maxPacket ||
+      (pkt->heap = client->allocator->alloc(client->allocator->ctx, hdrLen + len + 1)) == NULL) {
+
+    pbAbortSocket(client);
+    if (client->stats != NULL)
+      client->stats->tooBig++;
+
+    return PB_TOOBIG;
+  }
+
+  // Continue reading into allocated buffer.
+  pkt->allocator = client->allocator;
+  memcpy(pkt->heap, pkt->buf, hdrLen);
+  pkt->start = pkt->heap;
+  return PB_SUCCESS;
+}
+
+/*
+ * Bookkeeping after packet has been completely read.
+ */
+static int packetRead(PbClient* client, PbPacket* pkt, uint8_t* end)
+{
+  int type;
+
+  pkt->ptr = pkt->start;
+  pkt->end = end;
+
+  // Get packet type from header.
+  type = pbReadHeader(pkt, NULL);
+  
+  // Put pointer back to packet start.
+  pkt->ptr = pkt->start;
+  PB_TRACE3(read_done, client, type, pkt->end - pkt->start);
+
+  if (client->latency != NULL)
+    pbLatencyReceived(client->latency, type);
+
+  if (client->stats != NULL)
+    pbStatsPacket(client->stats, false, pkt->start, pkt->end - pkt->start);
+
+  if (client->recorder != NULL)
+    pbRecordPacket(client->recorder, PB_RECORD_RX, pkt->start, pkt->end - pkt->start);
+
+  return type;
+}
+
 int pbReadPacket(PbClient* client)
 {
-  uint8_t* ptr = client->packet.buf;
+  PbPacket* pkt;
+  int       st;
 
-  client->packet.start    = client->packet.buf;
-  client->packet.overflow = false;
+  pkt = startRead(client);
+
+  uint8_t* ptr = pkt->buf;
 
 // Read header
 
   if (client->readPacket(client, ptr, 1) != 1) {
  
+    if (client->stats != NULL)
+      client->stats->timeouts++;
+
     return PB_TIMEOUT;
   }
 
+  PB_TRACE2(read_start, client, *ptr);
   ++ptr;
   int multiplier = 1;
   int len = 0;
@@ -113,41 +294,115 @@ int pbReadPacket(PbClient* client)
 
   if (len) {
 
-    // reserve 1 extra byte at end of message, so
-    // it is possible to tack null character at
-    // end of payload - just to be C-string friendly.
-    if (ptr + len + 1 - client->packet.buf > POTATO_BUFSIZE) {
+    int hdrLen = ptr - pkt->buf;
 
-      close(client->sock);
-      client->sock = -1;
-      return PB_TOOBIG;
-    }
+    st = reserveBody(client, pkt, hdrLen, len);
+    if (st < 0)
+      return st;
+
+    ptr = pkt->start + hdrLen;
 
     int got;
 
-    while ((got = client->readPacket(client, ptr, len)) > 0) {
+    while (len > 0) {
     
-      if (got == -1)
+      // Body that ends early would leave stream out of
+      // sync, so treat it as connection failure.
+      got = client->readPacket(client, ptr, len);
+      if (got <= 0) {
+
+        pbAbortSocket(client);
         return PB_NETWORK;
+      }
 
       ptr += got;
       len -= got;
-      if (len == 0)
-        break;
+      if (len > 0 && client->stats != NULL)
+        client->stats->partialReads++;
     }
   }
 
-  int type;
+  return packetRead(client, pkt, ptr);
+}
 
-  client->packet.ptr = client->packet.start;
-  client->packet.end = ptr;
+int pbReadPacketAsync(PbClient* client, PbAsync* op)
+{
+  PbPacket* pkt;
+  int       st;
+  int       i;
+  int       multiplier;
 
-  // Get packet type from header.
-  type = pbReadHeader(&client->packet, NULL);
-  
-  // Put pointer back to packet start.
-  client->packet.ptr = client->packet.start;
-  return type;
+  if (op->pos == 0) {
+
+    pkt = startRead(client);
+    op->len = -1;
+  }
+  else
+    pkt = pbRxPacket(client);
+
+  // Header bytes are read one at a time, so that
+  // nothing from next packet is consumed.
+  while (op->len == -1) {
+
+    st = pbAsyncRead(client, op, pkt->buf + op->pos, 1);
+    if (st == PB_WOULDBLOCK)
+      return st;
+
+    if (st <= 0)
+      goto failed;
+
+    if (op->pos == 0) {
+
+      PB_TRACE2(read_start, client, pkt->buf[0]);
+    }
+
+    ++op->pos;
+    if (op->pos == 1 || (pkt->buf[op->pos - 1] & 0x80)) {
+
+      if (op->pos == PB_MAX_HEADER)
+        goto failed;
+
+      continue;
+    }
+
+    op->len    = 0;
+    multiplier = 1;
+    for (i = 1; i < op->pos; i++) {
+
+      op->len += (pkt->buf[i] & 0x7f) * multiplier;
+      multiplier *= 128;
+    }
+
+    st = reserveBody(client, pkt, op->pos, op->len);
+    if (st < 0) {
+
+      op->pos = 0;
+      return st;
+    }
+
+    // From now on len is total length of packet.
+    op->len += op->pos;
+  }
+
+  while (op->pos < op->len) {
+
+    st = pbAsyncRead(client, op, pkt->start + op->pos, op->len - op->pos);
+    if (st == PB_WOULDBLOCK)
+      return st;
+
+    if (st <= 0)
+      goto failed;
+
+    op->pos += st;
+  }
+
+  op->pos = 0;
+  return packetRead(client, pkt, pkt->start + op->len);
+
+failed:
+  pbAbortSocket(client);
+  op->pos = 0;
+  return PB_NETWORK;
 }
 
 int pbDisconnect(PbClient* client)
@@ -181,15 +436,44 @@ int pbPing(PbClient* client)
   return PB_SUCCESS;
 }
 
-int pbPublish(PbClient* client, PbPublish* arg)
+/*
+ * Deliver message to local subscribers and encode
+ * it into client packet. Returns 1 if packet must be
+ * sent to broker.
+ */
+static int encodePublish(PbClient* client, PbPublish* arg)
 {
   int st;
 
+  if (client->local != NULL) {
+
+    st = pbLocalPublish(client->local, arg);
+    if (client->local->forward == PB_LOCAL_FORWARD_NONE ||
+        (client->local->forward == PB_LOCAL_FORWARD_UNMATCHED && st > 0))
+      return 0;
+
+    ++client->local->forwarded;
+  }
+
   arg->packetId = pbGetPacketId(client);
-  st = pbWritePublish(&client->packet, arg);
+  if (client->codec != NULL)
+    st = pbWritePublishCodec(&client->packet, arg, client->codec);
+  else
+    st = pbWritePublish(&client->packet, arg);
   if (st < 0)
     return st;
 
+  return 1;
+}
+
+int pbPublish(PbClient* client, PbPublish* arg)
+{
+  int st;
+
+  st = encodePublish(client, arg);
+  if (st <= 0)
+    return st;
+
   st = pbWritePacket(client, &client->packet);
   if (st < 0)
     return st;
@@ -214,12 +498,125 @@ int pbSubscribe(PbClient* client, PbSubscribe* arg)
   return PB_SUCCESS;
 }
 
+static void keepAliveExpired(void* ctx)
+{
+  PbClient* client = ctx;
+
+  client->pingDue = true;
+}
+
+/*
+ * Wheel may be run by another client sharing it,
+ * so connection is closed later by pingNeeded.
+ */
+static void responseExpired(void* ctx)
+{
+  PbClient* client = ctx;
+
+  client->pingLost = true;
+}
+
+/*
+ * Run timers and check if keepalive timer has expired.
+ */
+static bool pingNeeded(PbClient* client)
+{
+  pbTimerWheelRun(client->timers);
+  if (client->pingLost) {
+
+    // No PINGRESP during keepalive period, connection is dead.
+    client->pingLost = false;
+    if (client->sock != -1) {
+
+      if (client->stats != NULL)
+        client->stats->timeouts++;
+
+      pbDisconnectSocket(client);
+    }
+  }
+
+  if (!client->pingDue || client->sock == -1)
+    return false;
+
+  client->pingDue = false;
+  return true;
+}
+
+/*
+ * Expect PINGRESP during next keepalive period.
+ */
+static void pingSent(PbClient* client)
+{
+  if (!pbTimerPending(&client->responseTimer))
+    pbTimerStart(client->timers, &client->responseTimer, client->keepAlive);
+}
+
+/*
+ * Send ping if keepalive timer has expired. Response
+ * is handled by normal event processing.
+ */
+static int pollTimers(PbClient* client)
+{
+  int st;
+
+  if (!pingNeeded(client))
+    return PB_SUCCESS;
+
+  st = pbWritePing(&client->packet);
+  if (st < 0)
+    return st;
+
+  st = pbWritePacket(client, &client->packet);
+  if (st < 0)
+    return st;
+
+  pingSent(client);
+  return PB_SUCCESS;
+}
+
+/*
+ * Data collected while corked must be sent before
+ * waiting for response to it, otherwise response
+ * never arrives.
+ */
+static int flushCorked(PbClient* client)
+{
+  if (client->corked && pbCork(client, false) < 0)
+    return PB_NETWORK;
+
+  return PB_SUCCESS;
+}
+
 int pbEvent(PbClient* client)
 {
-  if (client->sock == -1)
+  int type;
+
+  if (client->timers != NULL && client->sock != -1 && pollTimers(client) < 0)
+    return PB_NETWORK;
+
+  if (client->sock == -1 || flushCorked(client) < 0)
     return PB_NETWORK;
 
-  return pbReadPacket(client);
+  // Statistics are not worth dropping connection,
+  // just record the error unless socket was lost.
+  if (client->stats != NULL && (type = pbStatsPoll(client)) < 0) {
+
+    if (client->sock == -1)
+      return PB_NETWORK;
+
+    if (client->recorder != NULL)
+      pbRecordError(client->recorder, type);
+  }
+
+  // Timeout is normal result of idle connection.
+  type = pbReadPacket(client);
+  if (type < 0 && type != PB_TIMEOUT && client->recorder != NULL)
+    pbRecordError(client->recorder, type);
+
+  if (type == PB_MQ_PINGRESP && client->timers != NULL)
+    pbTimerCancel(client->timers, &client->responseTimer);
+
+  return type;
 }
 
 int pbWaitResponse(PbClient* client, int expect)
@@ -241,12 +638,43 @@ int pbWaitResponse(PbClient* client, int expect)
   return type;
 }
 
+/*
+ * Reset keepalive state for new connection.
+ */
+static void startSession(PbClient* client, PbConnect* arg)
+{
+  client->keepAlive = arg->keepAlive * 1000;
+  client->pingDue = false;
+  client->pingLost = false;
+
+  // Timers were initialized by pbClientInit, so
+  // canceling them is safe also on first connect.
+  if (client->timers != NULL) {
+
+    pbTimerCancel(client->timers, &client->keepAliveTimer);
+    pbTimerCancel(client->timers, &client->responseTimer);
+  }
+
+  pbTimerInit(&client->keepAliveTimer, keepAliveExpired, client);
+  pbTimerInit(&client->responseTimer, responseExpired, client);
+}
+
+static void countConnect(PbClient* client)
+{
+  if (client->stats != NULL) {
+
+    client->stats->connects++;
+    if (client->stats->connects > 1)
+      client->stats->reconnects++;
+  }
+}
+
 int pbConnect(PbClient*            client,
               const char*          url,
               PbConnect*           arg)
 {
   bool  ssl;
-  char  urlBuf[64];
+  char  urlBuf[128];
   PbUrl urlParts;
   int   st;
 
@@ -254,6 +682,8 @@ int pbConnect(PbClient*            client,
   if (pbUrlTok(&urlParts, urlBuf) == -1)
     return PB_BADURL;
 
+  pbSetOptions(client, arg->connectTimeout, arg->sockOpts);
+
   if (!strcmp(urlParts.protocol, "mqtt") || !strcmp(urlParts.protocol, "tcp")) {
 
     ssl = false;
@@ -275,6 +705,24 @@ int pbConnect(PbClient*            client,
     if (st != PB_SUCCESS)
       return st;
   }
+#endif
+#ifdef AF_UNIX
+  else if (!strcmp(urlParts.protocol, "unix")) {
+
+    ssl = false;
+    st = pbConnectSocket(client, &urlParts, NULL);
+    if (st != PB_SUCCESS)
+      return st;
+  }
+#endif
+#if POTATO_SHM
+  else if (!strcmp(urlParts.protocol, "shm")) {
+
+    ssl = false;
+    st = pbConnectSocket(client, &urlParts, NULL);
+    if (st != PB_SUCCESS)
+      return st;
+  }
 #endif
   else
     return PB_BADURL;
@@ -292,21 +740,230 @@ int pbConnect(PbClient*            client,
     setsockopt(client->sock, SOL_SOCKET, SO_RCVTIMEO, (char *)&tmo, sizeof(struct timeval));
   }
 
+  startSession(client, arg);
   st = pbWriteConnect(&client->packet, arg);
   if (st < 0) {
 
-    close(client->sock);
+    pbDisconnectSocket(client);
     return st;
   }
 
   st = pbWritePacket(client, &client->packet);
   if (st < 0) {
 
-    close(client->sock);
+    pbDisconnectSocket(client);
     return st;
   }
 
-  pbWaitResponse(client, PB_MQ_CONNACK);
+  st = pbWaitResponse(client, PB_MQ_CONNACK);
+  PB_TRACE2(mqtt_connected, client, st);
+  countConnect(client);
   return PB_SUCCESS;
 }
 
+/*
+ * Read packets until expected one arrives. Other
+ * packets are dropped like in pbWaitResponse.
+ */
+static int readResponse(PbClient* client, PbAsync* op, int expect)
+{
+  int type;
+
+  if (flushCorked(client) < 0)
+    return PB_NETWORK;
+
+  do {
+
+    type = pbReadPacketAsync(client, op);
+  } while (type >= 0 && type != expect);
+
+  return type;
+}
+
+int pbAsyncConnect(PbClient*  client,
+                   PbAsync*   op,
+                   const char* url,
+                   PbConnect* arg)
+{
+  char  urlBuf[128];
+  PbUrl urlParts;
+  int   st;
+
+  if (pbAsyncCheck(client, op) < 0)
+    return PB_TIMEOUT;
+
+  PB_ASYNC_BEGIN(op);
+
+  strlcpy(urlBuf, url, sizeof(urlBuf));
+  if (pbUrlTok(&urlParts, urlBuf) == -1)
+    PB_ASYNC_EXIT(op, PB_BADURL);
+
+  pbSetOptions(client, arg->connectTimeout, arg->sockOpts);
+  if (op->timeout == 0 && arg->connectTimeout)
+    op->deadline = pbClock() + (int64_t)arg->connectTimeout * 1000;
+
+  if (!strcmp(urlParts.protocol, "mqtt") || !strcmp(urlParts.protocol, "tcp")) {
+
+    if (urlParts.port == NULL)
+      urlParts.port = "1883";
+  }
+#ifdef AF_UNIX
+  else if (strcmp(urlParts.protocol, "unix"))
+#else
+  else
+#endif
+    PB_ASYNC_EXIT(op, PB_BADURL);
+
+  st = pbConnectSocketStart(client, &urlParts);
+  if (st < 0)
+    PB_ASYNC_EXIT(op, st);
+
+  PB_ASYNC_AWAIT(op, st, pbConnectSocketFinish(client, op));
+  if (st < 0)
+    PB_ASYNC_EXIT(op, st);
+
+  startSession(client, arg);
+  st = pbWriteConnect(&client->packet, arg);
+  if (st < 0) {
+
+    pbDisconnectSocket(client);
+    PB_ASYNC_EXIT(op, st);
+  }
+
+  PB_ASYNC_AWAIT(op, st, pbWritePacketAsync(client, &client->packet, op));
+  if (st < 0)
+    PB_ASYNC_EXIT(op, st);
+
+  PB_ASYNC_AWAIT(op, st, readResponse(client, op, PB_MQ_CONNACK));
+  PB_TRACE2(mqtt_connected, client, st);
+  if (st < 0)
+    PB_ASYNC_EXIT(op, st);
+
+  countConnect(client);
+  PB_ASYNC_END(op, PB_SUCCESS);
+}
+
+int pbAsyncSubscribe(PbClient* client, PbAsync* op, PbSubscribe* arg)
+{
+  int st;
+
+  if (pbAsyncCheck(client, op) < 0)
+    return PB_TIMEOUT;
+
+  PB_ASYNC_BEGIN(op);
+
+  arg->packetId = pbGetPacketId(client);
+  st = pbWriteSubscribe(&client->packet, arg);
+  if (st < 0)
+    PB_ASYNC_EXIT(op, st);
+
+  PB_ASYNC_AWAIT(op, st, pbWritePacketAsync(client, &client->packet, op));
+  if (st < 0)
+    PB_ASYNC_EXIT(op, st);
+
+  PB_ASYNC_AWAIT(op, st, readResponse(client, op, PB_MQ_SUBACK));
+  if (st < 0)
+    PB_ASYNC_EXIT(op, st);
+
+  PB_ASYNC_END(op, PB_SUCCESS);
+}
+
+int pbAsyncPublish(PbClient* client, PbAsync* op, PbPublish* arg)
+{
+  int st;
+
+  if (pbAsyncCheck(client, op) < 0)
+    return PB_TIMEOUT;
+
+  PB_ASYNC_BEGIN(op);
+
+  st = encodePublish(client, arg);
+  if (st <= 0)
+    PB_ASYNC_EXIT(op, st);
+
+  PB_ASYNC_AWAIT(op, st, pbWritePacketAsync(client, &client->packet, op));
+  if (st < 0)
+    PB_ASYNC_EXIT(op, st);
+
+  PB_ASYNC_END(op, PB_SUCCESS);
+}
+
+int pbAsyncPing(PbClient* client, PbAsync* op)
+{
+  int st;
+
+  if (pbAsyncCheck(client, op) < 0)
+    return PB_TIMEOUT;
+
+  PB_ASYNC_BEGIN(op);
+
+  st = pbWritePing(&client->packet);
+  if (st < 0)
+    PB_ASYNC_EXIT(op, st);
+
+  PB_ASYNC_AWAIT(op, st, pbWritePacketAsync(client, &client->packet, op));
+  if (st < 0)
+    PB_ASYNC_EXIT(op, st);
+
+  PB_ASYNC_AWAIT(op, st, readResponse(client, op, PB_MQ_PINGRESP));
+  if (st < 0)
+    PB_ASYNC_EXIT(op, st);
+
+  if (client->timers != NULL)
+    pbTimerCancel(client->timers, &client->responseTimer);
+
+  PB_ASYNC_END(op, PB_SUCCESS);
+}
+
+/*
+ * Read next packet. While nothing of it has been
+ * received, operation is left idle so that other
+ * operations can be started on client.
+ */
+static int readEvent(PbClient* client, PbAsync* op)
+{
+  int type;
+
+  type = pbReadPacketAsync(client, op);
+  if (type == PB_WOULDBLOCK && op->pos == 0)
+    op->pt = 0;
+
+  return type;
+}
+
+int pbAsyncEvent(PbClient* client, PbAsync* op)
+{
+  int st = PB_ERROR;
+
+  if (pbAsyncCheck(client, op) < 0)
+    return PB_TIMEOUT;
+
+  PB_ASYNC_BEGIN(op);
+
+  if (client->timers != NULL && pingNeeded(client)) {
+
+    st = pbWritePing(&client->packet);
+    if (st < 0)
+      PB_ASYNC_EXIT(op, st);
+
+    PB_ASYNC_AWAIT(op, st, pbWritePacketAsync(client, &client->packet, op));
+    if (st < 0)
+      PB_ASYNC_EXIT(op, st);
+
+    pingSent(client);
+  }
+
+  // Response timer may have closed connection.
+  if (client->sock == -1 || flushCorked(client) < 0)
+    PB_ASYNC_EXIT(op, PB_NETWORK);
+
+  PB_ASYNC_AWAIT(op, st, readEvent(client, op));
+  if (st < 0 && st != PB_TIMEOUT && client->recorder != NULL)
+    pbRecordError(client->recorder, st);
+
+  if (st == PB_MQ_PINGRESP && client->timers != NULL)
+    pbTimerCancel(client->timers, &client->responseTimer);
+
+  PB_ASYNC_END(op, st);
+}
+
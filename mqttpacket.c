@@ -326,3 +326,224 @@ int pbWriteDisconnect(PbPacket* pkt)
   return 0;
 }
 
+/*
+ * Read string after checking that it fits
+ * into packet. Used when parsing packets
+ * from peers that are not trusted.
+ */
+static const char* readCheckedString(PbPacket* pkt)
+{
+  int len;
+
+  if (pkt->end - pkt->ptr < 2)
+    return NULL;
+
+  len = (pkt->ptr[0] << 8) | pkt->ptr[1];
+  if (pkt->end - pkt->ptr - 2 < len)
+    return NULL;
+
+  return pbReadString(pkt);
+}
+
+int pbReadConnect(PbPacket* pkt, PbConnect* conn)
+{
+  const char* protocol;
+  int         level;
+  int         flags;
+
+  memset(conn, '\0', sizeof(PbConnect));
+
+  pbReadHeader(pkt, NULL);
+
+// Read variable header.
+
+  protocol = readCheckedString(pkt);
+  if (protocol == NULL || pkt->end - pkt->ptr < 4)
+    return -1;
+
+  if (strcmp(protocol, "MQTT") && strcmp(protocol, "MQIsdp"))
+    return -1;
+
+  level = pbReadByte(pkt);
+  flags = pbReadByte(pkt);
+  if (flags & 0x1) // reserved
+    return -1;
+
+  conn->keepAlive = pbReadInt(pkt);
+
+// Read payload.
+
+  conn->clientId = readCheckedString(pkt);
+  if (conn->clientId == NULL)
+    return -1;
+
+  if (flags & 0x4) { // will topic & message, not supported
+
+    if (readCheckedString(pkt) == NULL || readCheckedString(pkt) == NULL)
+      return -1;
+  }
+
+  if (flags & 0x80) {
+
+    conn->user = readCheckedString(pkt);
+    if (conn->user == NULL)
+      return -1;
+  }
+
+  if (flags & 0x40) {
+
+    conn->pass = readCheckedString(pkt);
+    if (conn->pass == NULL)
+      return -1;
+  }
+
+  return level;
+}
+
+int pbWriteConnectAck(PbPacket* pkt, PbConnectAck* ack)
+{
+  pbInitPacket(pkt);
+
+  pbWriteByte(pkt, ack->sessionPresent ? 1 : 0);
+  pbWriteByte(pkt, ack->returnCode);
+
+  pbWriteHeader(pkt, PB_MQ_CONNACK, 0, pbLength(pkt));
+
+  if (pkt->overflow)
+    return -1;
+
+  return 0;
+}
+
+/*
+ * Read next topic filter from subscribe
+ * or unsubscribe packet.
+ */
+static int readFilter(PbPacket* pkt, PbSubscribe* sub, bool qos)
+{
+  if (pkt->ptr == pkt->start) {
+
+    pbReadHeader(pkt, NULL);
+    if (pkt->end - pkt->ptr < 2)
+      return -1;
+
+    sub->packetId = pbReadInt(pkt);
+    if (pkt->ptr == pkt->end) // at least one filter is required
+      return -1;
+  }
+
+  if (pkt->ptr == pkt->end)
+    return 0;
+
+  sub->topic = readCheckedString(pkt);
+  if (sub->topic == NULL || sub->topic[0] == '\0')
+    return -1;
+
+  if (qos) {
+
+    if (pkt->ptr == pkt->end || *pkt->ptr > 2)
+      return -1;
+
+    pbReadByte(pkt);
+  }
+
+  return 1;
+}
+
+int pbReadSubscribe(PbPacket* pkt, PbSubscribe* sub)
+{
+  return readFilter(pkt, sub, true);
+}
+
+int pbReadUnsubscribe(PbPacket* pkt, PbSubscribe* sub)
+{
+  return readFilter(pkt, sub, false);
+}
+
+int pbWriteSubAck(PbPacket* pkt, int packetId, const uint8_t* codes, int count)
+{
+  pbInitPacket(pkt);
+
+  pbWriteInt(pkt, packetId);
+
+  PB_CHECK_SPACE(pkt, count);
+  memcpy(pkt->end, codes, count);
+  pkt->end += count;
+
+  pbWriteHeader(pkt, PB_MQ_SUBACK, 0, pbLength(pkt));
+
+  if (pkt->overflow)
+    return -1;
+
+  return 0;
+}
+
+/*
+ * Acks that contain only packet id.
+ */
+static int writeIdAck(PbPacket* pkt, int packetType, int packetId)
+{
+  pbInitPacket(pkt);
+
+  pbWriteInt(pkt, packetId);
+  pbWriteHeader(pkt, packetType, 0, pbLength(pkt));
+
+  if (pkt->overflow)
+    return -1;
+
+  return 0;
+}
+
+int pbWriteUnsubAck(PbPacket* pkt, int packetId)
+{
+  return writeIdAck(pkt, PB_MQ_UNSUBACK, packetId);
+}
+
+int pbWritePublishAck(PbPacket* pkt, int packetId)
+{
+  return writeIdAck(pkt, PB_MQ_PUBACK, packetId);
+}
+
+int pbWritePingResp(PbPacket* pkt)
+{
+  pbInitPacket(pkt);
+  pbWriteHeader(pkt, PB_MQ_PINGRESP, 0, pbLength(pkt));
+
+  if (pkt->overflow)
+    return -1;
+
+  return 0;
+}
+
+bool pbTopicMatch(const char* filter, const char* topic)
+{
+  // Wildcard at first level doesn't match $SYS etc.
+  if (*topic == '$' && (*filter == '+' || *filter == '#'))
+    return false;
+
+  while (*filter) {
+
+    if (*filter == '#')
+      return true;
+
+    if (*filter == '+') {
+
+      while (*topic && *topic != '/')
+        ++topic;
+
+      ++filter;
+      continue;
+    }
+
+    if (*filter != *topic) {
+
+      // "a/#" matches also parent level "a"
+      return *topic == '\0' && !strcmp(filter, "/#");
+    }
+
+    ++filter;
+    ++topic;
+  }
+
+  return *topic == '\0';
+}
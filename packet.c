@@ -53,6 +53,68 @@ void pbDump(PbPacket* pkt)
   printf("\n");
 }
 
+uint32_t pbHash(uint32_t hash, const void* data, size_t len)
+{
+  const uint8_t* ptr = data;
+
+  while (len--) {
+
+    hash ^= *ptr++;
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+int pbPublishTopic(const unsigned char* buf, int len, const unsigned char** topic)
+{
+  int pos;
+  int topicLen;
+
+  if (len < 2 || (buf[0] >> 4) != PB_MQ_PUBLISH)
+    return -1;
+
+  // Skip remaining length, topic follows it.
+  pos = 1;
+  while (pos < len && (buf[pos++] & 0x80))
+    ;
+
+  if (pos + 2 > len)
+    return -1;
+
+  topicLen = (buf[pos] << 8) | buf[pos + 1];
+  pos += 2;
+  if (pos + topicLen > len)
+    return -1;
+
+  *topic = buf + pos;
+  return topicLen;
+}
+
+static void* mallocAlloc(void* ctx, size_t size)
+{
+  return malloc(size);
+}
+
+static void mallocFree(void* ctx, void* ptr)
+{
+  free(ptr);
+}
+
+const PbAllocator pbMallocAllocator = { mallocAlloc, mallocFree, NULL };
+
+void pbFreePacket(PbPacket* pkt)
+{
+  if (pkt->heap == NULL)
+    return;
+
+  pkt->allocator->free(pkt->allocator->ctx, pkt->heap);
+  pkt->heap = NULL;
+  pkt->start = pkt->buf;
+  pkt->ptr = pkt->buf;
+  pkt->end = pkt->buf;
+}
+
 int pbRoomLeft(PbPacket* pkt)
 {
   return POTATO_BUFSIZE - (pkt->end - pkt->buf);
@@ -91,6 +153,13 @@ uint8_t pbReadByte(PbPacket* pkt)
   return b;
 }
 
+void pbNewPacket(PbPacket* pkt)
+{
+  pkt->heap      = NULL;
+  pkt->allocator = NULL;
+  pbInitPacket(pkt);
+}
+
 void pbInitPacket(PbPacket* pkt)
 {
   pkt->start    = pkt->buf + PB_MAX_HEADER;
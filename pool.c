@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "potato-pool.h"
+
+int pbPoolInit(PbPool* pool, PbLease* leases, int count)
+{
+  int i;
+
+  if (pbMutexInit(&pool->mutex) != PB_SUCCESS)
+    return PB_ERROR;
+
+  pool->free = NULL;
+  for (i = 0; i < count; i++) {
+
+    pbNewPacket(&leases[i].packet);
+    leases[i].pool = pool;
+    leases[i].refs = 0;
+    leases[i].next = pool->free;
+    pool->free = leases + i;
+  }
+
+  pool->available = count;
+  return PB_SUCCESS;
+}
+
+PbLease* pbPoolGet(PbPool* pool)
+{
+  PbLease* lease;
+
+  pbMutexLock(&pool->mutex);
+
+  lease = pool->free;
+  if (lease != NULL) {
+
+    pool->free = lease->next;
+    pool->available--;
+    lease->next = NULL;
+    lease->refs = 1;
+  }
+
+  pbMutexUnlock(&pool->mutex);
+  return lease;
+}
+
+PbLease* pbLeasePublish(PbClient* client, PbPublish* pub)
+{
+  PbLease* lease;
+
+  pbReadPublish(pbRxPacket(client), pub);
+
+  lease = client->lease;
+  client->lease = NULL;
+  return lease;
+}
+
+void pbLeaseRetain(PbLease* lease)
+{
+  pbMutexLock(&lease->pool->mutex);
+  lease->refs++;
+  pbMutexUnlock(&lease->pool->mutex);
+}
+
+void pbLeaseRelease(PbLease* lease)
+{
+  PbPool* pool = lease->pool;
+
+  pbMutexLock(&pool->mutex);
+
+  if (--lease->refs == 0) {
+
+    pbFreePacket(&lease->packet);
+    lease->next = pool->free;
+    pool->free = lease;
+    pool->available++;
+  }
+
+  pbMutexUnlock(&pool->mutex);
+}
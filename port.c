@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef USE_UNIX_SOCKETS
+
+#include <time.h>
+#include <pthread.h>
+
+#else
+
+#include <picoos.h>
+
+#endif
+
+#include "potato-bus.h"
+#include "potato-port.h"
+
+int64_t pbClock()
+{
+#ifdef USE_UNIX_SOCKETS
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+
+#else
+
+  static JIF_t   last;
+  static int64_t wraps;
+  JIF_t          now;
+
+  // Extend jiffies to 64 bits so that clock doesn't wrap.
+  now = jiffies;
+  if (now < last)
+    wraps += (int64_t)1 << (8 * sizeof(JIF_t));
+
+  last = now;
+  return (wraps + now) * (1000000 / HZ);
+
+#endif
+}
+
+void pbSleep(int ms)
+{
+#ifdef USE_UNIX_SOCKETS
+
+  usleep(ms * 1000);
+
+#else
+
+  posTaskSleep(MS(ms));
+
+#endif
+}
+
+#ifdef USE_UNIX_SOCKETS
+
+typedef struct {
+
+  void (*func)(void*);
+  void* arg;
+} TaskStart;
+
+static void* taskStart(void* arg)
+{
+  TaskStart start = *(TaskStart*)arg;
+
+  free(arg);
+  start.func(start.arg);
+  return NULL;
+}
+
+#endif
+
+int pbTaskCreate(void (*func)(void*), void* arg, const char* name)
+{
+#ifdef USE_UNIX_SOCKETS
+
+  pthread_t  thread;
+  TaskStart* start;
+
+  start = malloc(sizeof(TaskStart));
+  if (start == NULL)
+    return PB_ERROR;
+
+  start->func = func;
+  start->arg  = arg;
+
+  if (pthread_create(&thread, NULL, taskStart, start) != 0) {
+
+    free(start);
+    return PB_ERROR;
+  }
+
+  pthread_detach(thread);
+  return PB_SUCCESS;
+
+#else
+
+  if (nosTaskCreate(func, arg, POTATO_TASK_PRIO, POTATO_TASK_STACK, name) == NULL)
+    return PB_ERROR;
+
+  return PB_SUCCESS;
+
+#endif
+}
+
+int pbMutexInit(PbMutex* mutex)
+{
+#ifdef USE_UNIX_SOCKETS
+
+  pthread_mutexattr_t attr;
+
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  if (pthread_mutex_init(mutex, &attr) != 0)
+    return PB_ERROR;
+
+  pthread_mutexattr_destroy(&attr);
+  return PB_SUCCESS;
+
+#else
+
+  *mutex = posMutexCreate();
+  if (*mutex == NULL)
+    return PB_ERROR;
+
+  return PB_SUCCESS;
+
+#endif
+}
+
+void pbMutexLock(PbMutex* mutex)
+{
+#ifdef USE_UNIX_SOCKETS
+
+  pthread_mutex_lock(mutex);
+
+#else
+
+  posMutexLock(*mutex);
+
+#endif
+}
+
+void pbMutexUnlock(PbMutex* mutex)
+{
+#ifdef USE_UNIX_SOCKETS
+
+  pthread_mutex_unlock(mutex);
+
+#else
+
+  posMutexUnlock(*mutex);
+
+#endif
+}
+
+void pbMutexDestroy(PbMutex* mutex)
+{
+#ifdef USE_UNIX_SOCKETS
+
+  pthread_mutex_destroy(mutex);
+
+#else
+
+  posMutexDestroy(*mutex);
+
+#endif
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _POTATO_AGGREGATE_H
+#define _POTATO_AGGREGATE_H
+
+#include "potato-bus.h"
+#include "potato-json.h"
+
+/**
+ * @file    potato-aggregate.h
+ * @brief   Batching of high-rate sensor readings
+ */
+
+/** @defgroup aggregate   Message aggregation API
+ * Aggregator collects readings for a topic and publishes
+ * them as a single message when time window ends or
+ * buffer fills up. Aggregator uses only the buffer given
+ * to it when initialized.
+ *
+ * Batches are either JSON arrays made with JSON generator
+ * ([21.500000,21.600000,...]) or binary frames, which contain
+ * number of readings as 16-bit big-endian integer followed
+ * by readings as 32-bit big-endian IEEE 754 floats.
+ * @{
+ */
+
+/**
+ * Format of published batch.
+ */
+typedef enum {
+
+  PbAggregateJson,
+  PbAggregateBinary
+} PbAggregateFormat;
+
+/**
+ * Aggregator state.
+ */
+typedef struct {
+
+  PbClient*         client;
+  const char*       topic;
+  PbAggregateFormat format;
+  int               window;    // milliseconds
+  uint8_t*          buf;
+  int               size;
+  int               count;     // readings in current batch
+  int               len;       // bytes used by binary frame
+  int64_t           started;   // time of first reading in batch
+  JsonContext       json;
+  JsonNode*         array;
+} PbAggregator;
+
+/**
+ * Initialize aggregator.
+ * @param agg     Aggregator.
+ * @param client  Client used for publishing.
+ * @param topic   Topic for batches.
+ * @param format  Batch format.
+ * @param window  Max time in milliseconds from first reading to publish.
+ * @param buf     Buffer for batch. Its size is the byte budget of batch.
+ * @param size    Size of buffer.
+ */
+void pbAggregateInit(PbAggregator* agg,
+                     PbClient* client,
+                     const char* topic,
+                     PbAggregateFormat format,
+                     int window,
+                     void* buf,
+                     int size);
+
+/**
+ * Add reading to batch. Batch is published first if
+ * reading doesn't fit into it anymore, or if the time window
+ * has ended.
+ */
+int pbAggregate(PbAggregator* agg, double value);
+
+/**
+ * Publish batch if its time window has ended. Call this
+ * periodically, for example when pbEvent returns PB_TIMEOUT.
+ */
+int pbAggregatePoll(PbAggregator* agg);
+
+/**
+ * Publish current batch now.
+ */
+int pbAggregateFlush(PbAggregator* agg);
+
+/** @} */
+
+#endif /* _POTATO_AGGREGATE_H */
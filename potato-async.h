@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _POTATO_ASYNC_H
+#define _POTATO_ASYNC_H
+
+#include "potato-bus.h"
+
+/**
+ * @file    potato-async.h
+ * @brief   Resumable client operations
+ */
+
+/** @defgroup async   Resumable operation API
+ * Resumable operations allow many MQTT connections and HTTP
+ * requests to be driven from a single task without a stack
+ * for each of them. Each operation is a protothread-style
+ * coroutine: instead of blocking it returns PB_WOULDBLOCK
+ * and continues from saved state when called again with
+ * same arguments. Any other return value means that operation
+ * is complete. State is kept in a small PbAsync structure,
+ * one for each client.
+ *
+ * Socket of client is non-blocking while it is used with
+ * resumable operations. Only one operation can be in progress
+ * on a client at a time. pbAsyncEvent is idle while it
+ * waits for next packet to start, so other operations can
+ * be started when pbAsyncBusy returns false. If timeout
+ * of operation expires, connection is closed because stream
+ * state is unknown.
+ *
+ * Operations support tcp, mqtt, unix and http urls. TLS
+ * handshake is not resumable, so TLS urls return PB_BADURL.
+ * Name resolution uses endpoint cache and blocks only if
+ * host is not in it.
+ *
+ * Same macros can be used to write application coroutines
+ * that call resumable operations. Local variables are
+ * not preserved over PB_ASYNC_AWAIT and PB_ASYNC_YIELD,
+ * so state must be stored elsewhere, and switch statements
+ * cannot be used between PB_ASYNC_BEGIN and PB_ASYNC_END.
+ *
+ * Usage:
+ * @code
+ * typedef struct {
+ *
+ *   PbAsync   co;    // application coroutine
+ *   PbAsync   op;    // operation in progress
+ *   PbClient  client;
+ *   PbConnect cd;
+ *   PbSubscribe sub;
+ * } Conn;
+ *
+ * static int run(Conn* c)
+ * {
+ *   int st;
+ *
+ *   PB_ASYNC_BEGIN(&c->co);
+ *   PB_ASYNC_AWAIT(&c->co, st, pbAsyncConnect(&c->client, &c->op, url, &c->cd));
+ *   if (st < 0)
+ *     PB_ASYNC_EXIT(&c->co, st);
+ *
+ *   PB_ASYNC_AWAIT(&c->co, st, pbAsyncSubscribe(&c->client, &c->op, &c->sub));
+ *   while (st >= 0) {
+ *
+ *     PB_ASYNC_AWAIT(&c->co, st, pbAsyncEvent(&c->client, &c->op));
+ *     if (st == PB_MQ_PUBLISH)
+ *       handle message in c->client.packet
+ *   }
+ *
+ *   PB_ASYNC_END(&c->co, st);
+ * }
+ *
+ * for (i = 0; i < count; i++) {
+ *
+ *   pbClientInit(&conns[i].client);
+ *   pbAsyncInit(&conns[i].op, 0);
+ * }
+ *
+ * while (true) {
+ *
+ *   for (i = 0; i < count; i++)
+ *     if (run(&conns[i]) != PB_WOULDBLOCK)
+ *       restart connection later
+ *
+ *   pbAsyncWait(ops, count, 1000);
+ * }
+ * @endcode
+ * @{
+ */
+
+#define PB_ASYNC_NONE  0
+#define PB_ASYNC_READ  1
+#define PB_ASYNC_WRITE 2
+
+/**
+ * State of resumable operation. Must be zeroed or
+ * initialized with pbAsyncInit before first use.
+ */
+typedef struct pbAsync {
+
+  int      pt;        // resume point, 0 when idle
+  int      wait;      // PB_ASYNC_READ or PB_ASYNC_WRITE while blocked
+  int      sock;      // socket to wait for while blocked
+  int      timeout;   // milliseconds for whole operation, 0 = no limit
+  int64_t  deadline;  // pbClock when operation times out
+  int      pos;       // bytes transferred so far
+  int      len;       // bytes expected, -1 if not known yet
+  int      flags;     // operation specific
+} PbAsync;
+
+/**
+ * Start coroutine body. Unknown resume point (corrupted
+ * or foreign state) resets operation and returns PB_ERROR.
+ */
+#define PB_ASYNC_BEGIN(op)                            \
+  switch ((op)->pt) {                                 \
+    default:                                          \
+      (op)->pt = 0;                                   \
+      return PB_ERROR;                                \
+    case 0:
+
+/**
+ * Evaluate expression into st. If it returns PB_WOULDBLOCK,
+ * return it and evaluate expression again when resumed.
+ * Only one PB_ASYNC_AWAIT or PB_ASYNC_YIELD can be on a line.
+ */
+#define PB_ASYNC_AWAIT(op, st, expr)                  \
+  do {                                                \
+    (op)->pt = __LINE__;                              \
+    /* FALLTHROUGH */                                 \
+    case __LINE__:                                    \
+    (st) = (expr);                                    \
+    if ((st) == PB_WOULDBLOCK)                        \
+      return PB_WOULDBLOCK;                           \
+  } while (0)
+
+/**
+ * Return PB_WOULDBLOCK and continue after this
+ * point when resumed.
+ */
+#define PB_ASYNC_YIELD(op)                            \
+  do {                                                \
+    (op)->pt = __LINE__;                              \
+    return PB_WOULDBLOCK;                             \
+    case __LINE__:;                                   \
+  } while (0)
+
+/**
+ * Complete coroutine early with result st.
+ */
+#define PB_ASYNC_EXIT(op, st)                         \
+  do {                                                \
+    (op)->pt = 0;                                     \
+    return (st);                                      \
+  } while (0)
+
+/**
+ * End coroutine body and complete it with result st.
+ */
+#define PB_ASYNC_END(op, st) } (op)->pt = 0; return (st)
+
+/**
+ * Initialize operation state. Timeout is in milliseconds,
+ * zero means no limit.
+ */
+void pbAsyncInit(PbAsync* op, int timeout);
+
+/**
+ * Check if operation is in progress.
+ */
+bool pbAsyncBusy(const PbAsync* op);
+
+/**
+ * Called at start of each resumable operation. Starts
+ * timeout if operation is idle. If operation has timed out,
+ * disconnects client, resets operation and returns PB_TIMEOUT.
+ */
+int pbAsyncCheck(PbClient* client, PbAsync* op);
+
+/**
+ * Read at most len bytes without blocking. Returns number of
+ * bytes read, zero at end of stream, PB_WOULDBLOCK if no
+ * data is available or PB_NETWORK.
+ */
+int pbAsyncRead(PbClient* client, PbAsync* op, uint8_t* buf, int len);
+
+/**
+ * Write len bytes without blocking. op->pos counts bytes written
+ * and must be zero when starting. Returns PB_SUCCESS when all
+ * data has been written, PB_WOULDBLOCK or PB_NETWORK.
+ */
+int pbAsyncWrite(PbClient* client, PbAsync* op, const uint8_t* buf, int len);
+
+/**
+ * Wait until some of blocked operations can proceed or
+ * timeout (milliseconds, -1 = forever) expires. Idle operations
+ * are ignored. If no operation is blocked and timeout is -1,
+ * returns zero at once instead of waiting forever. Returns
+ * number of ready operations, zero on timeout or PB_ERROR.
+ * With lwIP select is used and descriptors must be below
+ * FD_SETSIZE.
+ */
+int pbAsyncWait(PbAsync* const* ops, int count, int timeout);
+
+/**
+ * Start non-blocking connect to first address of url host,
+ * or to unix socket. Client uses plain socket transport
+ * and socket is left in non-blocking mode. Previous
+ * connection of client is closed if still open.
+ */
+int pbConnectSocketStart(PbClient* client, const PbUrl* url);
+
+/**
+ * Complete connect started by pbConnectSocketStart.
+ * Returns PB_WOULDBLOCK while connect is in progress.
+ */
+int pbConnectSocketFinish(PbClient* client, PbAsync* op);
+
+/**
+ * Write MQTT packet without blocking. op->pos must be zero
+ * when starting. Returns packet length when complete.
+ */
+int pbWritePacketAsync(PbClient* client, PbPacket* pkt, PbAsync* op);
+
+/**
+ * Read MQTT packet without blocking. op->pos must be zero
+ * when starting. Returns packet type when complete.
+ */
+int pbReadPacketAsync(PbClient* client, PbAsync* op);
+
+/**
+ * Resumable version of pbConnect. Timeout of
+ * operation defaults to arg->connectTimeout.
+ */
+int pbAsyncConnect(PbClient* client, PbAsync* op, const char* url, PbConnect* arg);
+
+/**
+ * Resumable version of pbSubscribe. Completes
+ * when SUBACK is received.
+ */
+int pbAsyncSubscribe(PbClient* client, PbAsync* op, PbSubscribe* arg);
+
+/**
+ * Resumable version of pbPublish. Completes
+ * when packet has been written.
+ */
+int pbAsyncPublish(PbClient* client, PbAsync* op, PbPublish* arg);
+
+/**
+ * Resumable version of pbPing. Completes when
+ * PINGRESP is received.
+ */
+int pbAsyncPing(PbClient* client, PbAsync* op);
+
+/**
+ * Resumable version of pbEvent. If client->timers is set,
+ * keepalive PINGREQ is sent when due. Returns packet type
+ * when a packet has been received. Operation is idle
+ * while no packet has been started.
+ */
+int pbAsyncEvent(PbClient* client, PbAsync* op);
+
+/**
+ * Resumable version of pbGet for http urls. Url is
+ * copied into client packet buffer on first call.
+ * Socket options (NULL = defaults) apply to this request only.
+ */
+int pbAsyncGet(PbClient*              client,
+               PbAsync*               op,
+               const char*            url,
+               const PbSocketOptions* sockOpts);
+
+/** @} */
+
+#endif /* _POTATO_ASYNC_H */
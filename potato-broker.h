@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _POTATO_BROKER_H
+#define _POTATO_BROKER_H
+
+#include "potato-bus.h"
+#include "potato-timer.h"
+
+/**
+ * @file    potato-broker.h
+ * @brief   Embedded MQTT broker
+ */
+
+/** @defgroup broker   Embedded broker API
+ * Small MQTT 3.1.1 broker for fanning out local data to
+ * local consumers without separate broker process. It is also
+ * useful as stand-in broker for tests and benchmarks.
+ *
+ * Broker runs on epoll event loop, so it is available
+ * only on Linux hosts. Keepalive deadlines of sessions
+ * are kept in timer wheel (see @ref timer). All memory is in PbBroker structure:
+ * number of sessions, topic tree nodes and per-session
+ * output buffer are fixed at compile time. Packets larger
+ * than POTATO_BUFSIZE are rejected.
+ *
+ * Subscriptions are kept in topic tree, where each node has
+ * a bit for each subscribed session. PUBLISH is encoded once
+ * and same bytes are written to every matching subscriber.
+ * Only QOS 0 is delivered (QOS 1 publish is acknowledged and
+ * delivered as QOS 0). Retained messages, wills and persistent
+ * sessions are not supported. If subscriber doesn't keep up,
+ * messages that don't fit into its output buffer are dropped.
+ *
+ * Usage:
+ * @code
+ * static PbBroker broker;
+ *
+ * pbBrokerInit(&broker);
+ * pbBrokerListen(&broker, "mqtt://127.0.0.1:1883");
+ * while (true)
+ *   pbBrokerPoll(&broker, 1000);
+ * @endcode
+ * @{
+ */
+
+#ifndef POTATO_BROKER
+#if defined(USE_UNIX_SOCKETS) && defined(__linux__)
+#define POTATO_BROKER 1
+#else
+#define POTATO_BROKER 0
+#endif
+#endif
+
+/**
+ * Max number of client sessions.
+ */
+#ifndef POTATO_BROKER_SESSIONS
+#define POTATO_BROKER_SESSIONS 64
+#endif
+
+/**
+ * Number of topic tree nodes. Each level of
+ * subscription filter uses one node, nodes are shared
+ * by filters having same prefix.
+ */
+#ifndef POTATO_BROKER_NODES
+#define POTATO_BROKER_NODES 256
+#endif
+
+/**
+ * Max length of single level in subscription filter.
+ */
+#ifndef POTATO_BROKER_LEVEL
+#define POTATO_BROKER_LEVEL 32
+#endif
+
+/**
+ * Max length of client id.
+ */
+#ifndef POTATO_BROKER_CLIENT_ID
+#define POTATO_BROKER_CLIENT_ID 64
+#endif
+
+/**
+ * Size of session output buffer.
+ */
+#ifndef POTATO_BROKER_OUTBUF
+#define POTATO_BROKER_OUTBUF (2 * POTATO_BUFSIZE)
+#endif
+
+/**
+ * Max number of listen sockets.
+ */
+#ifndef POTATO_BROKER_LISTEN
+#define POTATO_BROKER_LISTEN 2
+#endif
+
+/**
+ * Milliseconds new connection has time to send CONNECT.
+ */
+#ifndef POTATO_BROKER_CONNECT_TIME
+#define POTATO_BROKER_CONNECT_TIME 10000
+#endif
+
+#if POTATO_BROKER_OUTBUF < POTATO_BUFSIZE
+#error POTATO_BROKER_OUTBUF must be at least POTATO_BUFSIZE
+#endif
+
+#define PB_BROKER_WORDS ((POTATO_BROKER_SESSIONS + 31) / 32)
+
+/**
+ * Set of sessions, bit for each.
+ */
+typedef struct {
+
+  uint32_t bits[PB_BROKER_WORDS];
+} PbBrokerSet;
+
+/**
+ * Topic tree node.
+ */
+typedef struct {
+
+  int16_t     child;           // first child, -1 = none
+  int16_t     next;            // next sibling or free node, -1 = none
+  PbBrokerSet subs;            // sessions subscribed to filter ending here
+  char        level[POTATO_BROKER_LEVEL];
+} PbBrokerNode;
+
+/**
+ * Client session.
+ */
+typedef struct {
+
+  int           fd;            // -1 = free
+  bool          connected;     // CONNECT has been received
+  int           keepAlive;     // seconds, 0 = none
+  PbTimer       timer;         // keepalive deadline
+  struct pbBroker* broker;
+  int           inLen;
+  int           outLen;
+  char          clientId[POTATO_BROKER_CLIENT_ID];
+  unsigned char in[POTATO_BUFSIZE];
+  unsigned char out[POTATO_BROKER_OUTBUF];
+} PbBrokerSession;
+
+/**
+ * Broker state.
+ */
+typedef struct pbBroker {
+
+  int             epoll;
+  int             listen[POTATO_BROKER_LISTEN];
+  bool            tcp[POTATO_BROKER_LISTEN];
+  int16_t         freeNode;
+  PbTimerWheel    timers;
+  PbPacket        tx;
+  PbBrokerNode    nodes[POTATO_BROKER_NODES]; // node 0 is root
+  PbBrokerSession sessions[POTATO_BROKER_SESSIONS];
+
+  // Counters.
+  uint32_t        published;   // PUBLISH packets received
+  uint32_t        delivered;   // PUBLISH packets sent to subscribers
+  uint32_t        dropped;     // PUBLISH packets dropped, output buffer full
+} PbBroker;
+
+#if POTATO_BROKER
+
+/**
+ * Initialize broker.
+ */
+int pbBrokerInit(PbBroker* broker);
+
+/**
+ * Start listening for clients in URL, which is
+ * like mqtt://host[:port], tcp://host[:port] or unix:///path.
+ * Empty host or * listens on all addresses.
+ */
+int pbBrokerListen(PbBroker* broker, const char* url);
+
+/**
+ * Wait for network events for at most timeout milliseconds
+ * and process them. Wait is shortened to next keepalive
+ * deadline. Returns number of events processed or PB_ERROR.
+ */
+int pbBrokerPoll(PbBroker* broker, int timeout);
+
+/**
+ * Publish message from application to subscribers.
+ * Returns number of subscribers message was sent to
+ * or PB_ERROR if topic is not valid.
+ */
+int pbBrokerPublish(PbBroker* broker, PbPublish* pub);
+
+/**
+ * Close all connections and listen sockets.
+ */
+void pbBrokerClose(PbBroker* broker);
+
+#endif
+
+/** @} */
+
+#endif /* _POTATO_BROKER_H */
@@ -60,6 +60,21 @@ typedef void mbedtls_ssl_config;
  * - @ref mqttpacket
  * - @ref httpclient
  * - @ref common
+ * - @ref aggregate
+ * - @ref async
+ * - @ref broker
+ * - @ref capture
+ * - @ref codec
+ * - @ref impair
+ * - @ref latency
+ * - @ref local
+ * - @ref shard
+ * - @ref shm
+ * - @ref stats
+ * - @ref trace
+ * - @ref pool
+ * - @ref record
+ * - @ref timer
  * - @ref json
  * @section overview Overview
  * This library contains a simple MQTT client implementation for pico]OS, but
@@ -103,6 +118,7 @@ typedef void mbedtls_ssl_config;
  * Return codes.
  */
 
+#define PB_WOULDBLOCK -8
 #define PB_HTTP    -7
 #define PB_BADURL  -6
 #define PB_MBEDTLS -5
@@ -124,6 +140,80 @@ typedef void mbedtls_ssl_config;
 #define POTATO_BUFSIZE 512
 #endif
 
+/**
+ * Save TLS session after handshake and offer
+ * it when reconnecting to same endpoint.
+ */
+#ifndef POTATO_TLS_RESUME
+#define POTATO_TLS_RESUME 1
+#endif
+
+/**
+ * Support for Linux kernel TLS offload.
+ */
+#ifndef POTATO_KTLS
+#if POTATO_TLS && defined(USE_UNIX_SOCKETS) && defined(__linux__) && defined(MBEDTLS_SSL_EXPORT_KEYS)
+#define POTATO_KTLS 1
+#else
+#define POTATO_KTLS 0
+#endif
+#endif
+
+/**
+ * Size of buffer used to read ahead TLS ciphertext.
+ */
+#ifndef POTATO_TLS_BIO_SIZE
+#define POTATO_TLS_BIO_SIZE 1024
+#endif
+
+/**
+ * Initial value for pbHash.
+ */
+#define PB_HASH_INIT 2166136261u
+
+/**
+ * Max number of resolved addresses tried when connecting.
+ */
+#ifndef POTATO_CONNECT_ADDRS
+#define POTATO_CONNECT_ADDRS 8
+#endif
+
+/**
+ * Max number of connection attempts in progress
+ * simultaneously.
+ */
+#ifndef POTATO_CONNECT_ATTEMPTS
+#define POTATO_CONNECT_ATTEMPTS 4
+#endif
+
+/**
+ * Delay in milliseconds before starting connection
+ * attempt to next address while previous ones
+ * are still in progress.
+ */
+#ifndef POTATO_CONNECT_DELAY
+#define POTATO_CONNECT_DELAY 250
+#endif
+
+/**
+ * Socket tuning options. Zero values leave
+ * platform defaults in effect. Options are applied
+ * to socket before TLS handshake, so they are in
+ * effect for both plain and TLS connections.
+ */
+typedef struct {
+
+  bool noDelay;                // disable Nagle algorithm (TCP_NODELAY)
+  int  sendBuf;                // SO_SNDBUF size
+  int  recvBuf;                // SO_RCVBUF size
+  int  userTimeout;            // TCP_USER_TIMEOUT, milliseconds
+  int  keepIdle;               // seconds before TCP keepalive probes, 0 = no keepalive
+  int  keepInterval;           // seconds between TCP keepalive probes
+  int  keepCount;              // number of unanswered probes before giving up
+  bool cork;                   // use TCP_CORK in pbCork
+  bool ktls;                   // hand TLS records to kernel after handshake (Linux)
+} PbSocketOptions;
+
 /**
  * Data for publish packet.
  */
@@ -163,6 +253,8 @@ typedef struct {
   const char* user;
   const char* pass;
   mbedtls_ssl_config* sslConf;
+  int connectTimeout;          // milliseconds, 0 = no limit
+  const PbSocketOptions* sockOpts; // copied at connect, NULL = defaults
 } PbConnect;
   
 /**
@@ -174,6 +266,34 @@ typedef struct {
   int returnCode;
 } PbConnectAck;
 
+/**
+ * Memory allocator for packets that don't fit
+ * into POTATO_BUFSIZE.
+ */
+typedef struct pbAllocator {
+
+  void* (*alloc)(void* ctx, size_t size);
+  void  (*free)(void* ctx, void* ptr);
+  void* ctx;
+} PbAllocator;
+
+/**
+ * Timer in timer wheel, see @ref timer.
+ */
+typedef struct pbTimer {
+
+  struct pbTimer*  next;
+  struct pbTimer** pprev;      // NULL when timer is not pending
+  uint64_t         expires;    // tick
+  void           (*func)(void* ctx);
+  void*            ctx;
+} PbTimer;
+
+/**
+ * Allocator using malloc & free.
+ */
+extern const PbAllocator pbMallocAllocator;
+
 /**
  * Packet reader/writer work area.
  */
@@ -184,9 +304,23 @@ typedef struct {
   unsigned char* ptr;
   unsigned char* end;
   bool overflow;
+  unsigned char* heap;         // allocated buffer for large packet, if any
+  const PbAllocator* allocator;
 
 } PbPacket;
 
+struct pbPool;
+struct pbLease;
+struct pbCodec;
+struct pbLatency;
+struct pbStats;
+struct pbRecorder;
+struct pbCapture;
+struct pbImpair;
+struct pbLocalBus;
+struct pbShm;
+struct pbTimerWheel;
+
 /**
  * Client handle.
  */
@@ -194,16 +328,54 @@ typedef struct pbClient {
   
   int sock;
   int packetId;
+  int connectTimeout;          // milliseconds, 0 = no limit
+  PbSocketOptions sockOpts;    // copied from PbConnect
+  bool corked;
+  bool shared;                 // socket is used by several tasks
   PbPacket packet;
+  struct pbPool*  pool;        // receive buffer pool for leases, optional
+  struct pbLease* lease;       // buffer for next received packet
+  const PbAllocator* allocator; // allocator for large packets, optional
+  int maxPacket;               // max size of allocated packet
+  const struct pbCodec* codec; // compress published messages, optional
+  struct pbLatency* latency;   // latency histograms, optional
+  struct pbStats* stats;       // statistics, optional
+  struct pbRecorder* recorder; // flight recorder, optional
+  struct pbCapture* capture;   // capture of received data, optional
+  struct pbImpair* impair;     // network impairment for testing, optional
+  struct pbLocalBus* local;    // in-process bus for local subscribers, optional
+  struct pbShm* shm;           // shared memory transport state, for shm:// urls
+  struct pbTimerWheel* timers; // keepalive deadlines, optional
+  int keepAlive;               // milliseconds
+  bool pingDue;                // keepalive timer has expired
+  bool pingLost;               // no PINGRESP during keepalive period
+  PbTimer keepAliveTimer;
+  PbTimer responseTimer;
+  void* transportCtx;          // state of custom transport
 
   int (*writePacket)(struct pbClient*, const unsigned char*, size_t);
   int (*readPacket)(struct pbClient*, unsigned char*, size_t);
+  int (*flushPacket)(struct pbClient*);
   int (*closeConnection)(struct pbClient*);
 
 #if POTATO_TLS
 
   mbedtls_ssl_context      ssl;
   int                      sslResult;
+  unsigned char            sslIn[POTATO_TLS_BIO_SIZE];
+  int                      sslInPos;
+  int                      sslInLen;
+  unsigned char            sslOut[POTATO_BUFSIZE];
+  int                      sslOutLen;
+#if POTATO_KTLS
+  unsigned char            ktlsKeys[2 * 32 + 2 * 4];
+  int                      ktlsKeyLen;
+#endif
+#if POTATO_TLS_RESUME
+  mbedtls_ssl_session      session;
+  uint32_t                 sessionKey;
+  bool                     sessionValid;
+#endif
 
 #endif
 } PbClient;
@@ -232,26 +404,98 @@ typedef struct {
  * 
  * Note that input string is modified and PbUrl 
  * structure contains pointers to it.
+ *
+ * For unix:///path/to/socket URLs host is empty
+ * and path contains the absolute socket path.
  */
 int pbUrlTok(PbUrl* url, char* urlString);
 
 /**
- * Connect socket to URL.
+ * Connect socket to URL. Protocol "unix" connects
+ * to a local unix domain stream socket at url path.
+ *
+ * If host resolves to several addresses, connection
+ * attempts are raced against each other (RFC 8305 happy eyeballs)
+ * and first one to complete is used. Whole operation
+ * is limited by client->connectTimeout, PB_TIMEOUT is
+ * returned if it expires. With lwIP addresses are tried
+ * in order using blocking connect and timeout is not used.
+ *
+ * For TLS connections handshake is performed here.
+ * If sockOpts->ktls is set and platform supports it,
+ * TLS 1.2 AES-GCM connections are handed to Linux kernel
+ * TLS after handshake. Note that this installs key export
+ * callback into sslConf for duration of handshake and clears
+ * it afterwards, so sslConf must not be used for simultaneous
+ * handshakes in other tasks and it cannot have a callback
+ * of its own.
+ * TLS session is saved in client and offered when
+ * reconnecting to same host and port, which makes the
+ * reconnect handshake cheap if server accepts it.
  */
 int pbConnectSocket(PbClient*            client,
                     const PbUrl*         url,
                     mbedtls_ssl_config*  sslConf);
 
+/**
+ * Initialize client. Must be called once before
+ * client is used and before optional fields (pool,
+ * stats, timers etc.) are set.
+ */
+void pbClientInit(PbClient* client);
+
+/**
+ * Set connect timeout (milliseconds, 0 = no limit) and
+ * socket options for next connection. Options are copied,
+ * NULL selects platform defaults.
+ */
+void pbSetOptions(PbClient* client, int connectTimeout, const PbSocketOptions* sockOpts);
+
+/**
+ * Cork or uncork connection. While connection is corked,
+ * small writes are collected to full segments and
+ * TLS records. Uncorking sends pending data. Use
+ * around batches of writes. pbEvent and functions that
+ * wait for a response uncork connection first, so that
+ * request isn't left in buffer.
+ */
+int pbCork(PbClient* client, bool cork);
+
 /**
  * Disconnect socket.
  */
 int pbDisconnectSocket(PbClient* client);
 
 /**
- * Write dump of packet to stdout. Useful for debugging.
+ * Drop connection after I/O error. Normally socket is
+ * closed at once. If client->shared is set, other tasks
+ * may be using the descriptor, so it is only shut down
+ * and the owner task must close it with pbDisconnectSocket.
+ * Shared sockets are refused for TLS unless records are
+ * handled by kernel (PbSocketOptions.ktls).
+ */
+void pbAbortSocket(PbClient* client);
+
+/**
+ * Write dump of packet to stdout. Useful for debugging,
+ * see @ref record for production use.
  */
 void pbDump(PbPacket* pkt);
 
+/**
+ * Calculate FNV-1a hash of data. Use PB_HASH_INIT
+ * as initial hash value or hash of previous data
+ * to continue.
+ */
+uint32_t pbHash(uint32_t hash, const void* data, size_t len);
+
+/**
+ * Locate topic in raw PUBLISH packet (starting from
+ * fixed header). Returns topic length or -1 if packet
+ * is not a valid PUBLISH.
+ */
+int pbPublishTopic(const unsigned char* buf, int len, const unsigned char** topic);
+
 /**
  * Write a byte to packet buffer.
  */
@@ -267,11 +511,24 @@ uint8_t pbReadByte(PbPacket* pkt);
  */
 int pbLength(PbPacket* pkt);
 
+/**
+ * Initialize new packet. Must be called once for every
+ * packet buffer before it is used, it clears heap buffer
+ * so that pbFreePacket doesn't touch garbage.
+ */
+void pbNewPacket(PbPacket* pkt);
+
 /**
  * Initialize packet. Must be called before writing/reading.
  */
 void pbInitPacket(PbPacket* pkt);
 
+/**
+ * Release allocated buffer of large packet.
+ * Packet uses its fixed buffer after this.
+ */
+void pbFreePacket(PbPacket* pkt);
+
 /**
  * Calculate remaining buffer space.
  */
@@ -295,11 +552,22 @@ bool pbHasRoom(PbPacket* pkt, int n);
  */
 
 /**
- * Perform HTTP get.
+ * Perform HTTP get using default connect options.
  */
-int pbGet(PbClient*            client,
-          const char*          url,
-          mbedtls_ssl_config*  sslConf);
+int pbGet(PbClient*              client,
+          const char*            url,
+          mbedtls_ssl_config*    sslConf);
+
+/**
+ * Perform HTTP get. Connect timeout (milliseconds,
+ * 0 = no limit) and socket options (NULL = defaults) apply
+ * to this request only.
+ */
+int pbGetEx(PbClient*              client,
+            const char*            url,
+            mbedtls_ssl_config*    sslConf,
+            int                    connectTimeout,
+            const PbSocketOptions* sockOpts);
 
 /** @} */
 
@@ -315,15 +583,27 @@ int pbGet(PbClient*            client,
 int pbGetPacketId(PbClient *c);
 
 /**
- * Write given packet to broker socket.
+ * Write given packet to broker socket. Packet
+ * is sent immediately unless connection is corked.
  */
 int pbWritePacket(PbClient* client, PbPacket* pkt);
 
 /**
- * Read next packet from broker socket.
+ * Read next packet from broker socket. If packet doesn't
+ * fit into POTATO_BUFSIZE and client has an allocator,
+ * a buffer up to client->maxPacket bytes is allocated for it.
+ * The buffer is released when next packet is read.
+ * Otherwise connection is closed and PB_TOOBIG returned.
  */
 int pbReadPacket(PbClient* client);
 
+/**
+ * Get buffer containing packet read by pbReadPacket.
+ * This is client->packet unless client has
+ * a receive buffer pool.
+ */
+PbPacket* pbRxPacket(PbClient* client);
+
 /**
  * Connect to MQTT broker using URL and wait for it to acknowledge new connection.
  * URL should be like
@@ -331,9 +611,15 @@ int pbReadPacket(PbClient* client);
  *   tcp://server[:port], 
  *   mqtts://server[:port], 
  *   ssl://server[:port] 
+ *   unix:///path/to/socket
+ *   shm://name
  * 
  * mqtt: is alias for tcp: and mqtts: is alias for ssl:.
  * Default port is 1883 for tcp and 8883 for ssl.
+ * unix: connects to a broker on same host using unix domain
+ * socket, if platform supports it. shm: exchanges messages
+ * with processes on same host through shared memory
+ * (see @ref shm), client->shm must be set.
  */
 int pbConnect(PbClient*            client,
               const char*          url,
@@ -349,7 +635,10 @@ bool pbIsSSL_URL(const char* url);
 int pbPing(PbClient* client);
 
 /**
- * Publish new data to given topic.
+ * Publish new data to given topic. If client
+ * has a codec, message is compressed with it.
+ * If client has a local bus, message is delivered
+ * to local subscribers first (see @ref local).
  */
 int pbPublish(PbClient* client, PbPublish* arg);
 
@@ -460,6 +749,62 @@ int pbWritePing(PbPacket* pkt);
  */
 int pbWriteDisconnect(PbPacket* pkt);
 
+/**
+ * Read connect packet. Functions below are for
+ * broker side and check packet bounds, as packet comes
+ * from untrusted peer. Strings in conn point to
+ * packet buffer. Will topic and message are skipped.
+ * Returns protocol level (4 for MQTT 3.1.1) or
+ * -1 if packet is malformed.
+ */
+int pbReadConnect(PbPacket* pkt, PbConnect* conn);
+
+/**
+ * Write connect ack.
+ */
+int pbWriteConnectAck(PbPacket* pkt, PbConnectAck* ack);
+
+/**
+ * Read next topic filter from subscribe packet.
+ * Packet id is read on first call. Returns 1
+ * when sub->topic is set, 0 when there are no more
+ * filters or -1 if packet is malformed.
+ */
+int pbReadSubscribe(PbPacket* pkt, PbSubscribe* sub);
+
+/**
+ * Read next topic filter from unsubscribe packet,
+ * like pbReadSubscribe.
+ */
+int pbReadUnsubscribe(PbPacket* pkt, PbSubscribe* sub);
+
+/**
+ * Write subscription ack with return code for
+ * each filter in subscribe packet.
+ */
+int pbWriteSubAck(PbPacket* pkt, int packetId, const uint8_t* codes, int count);
+
+/**
+ * Write unsubscribe ack.
+ */
+int pbWriteUnsubAck(PbPacket* pkt, int packetId);
+
+/**
+ * Write publish ack (for QOS 1 publish).
+ */
+int pbWritePublishAck(PbPacket* pkt, int packetId);
+
+/**
+ * Write ping response packet.
+ */
+int pbWritePingResp(PbPacket* pkt);
+
+/**
+ * Check if topic matches subscription filter,
+ * which may contain + and # wildcards.
+ */
+bool pbTopicMatch(const char* filter, const char* topic);
+
 /** @} */
 
 #endif /* _POTATO_BUS_H */
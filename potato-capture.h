@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _POTATO_CAPTURE_H
+#define _POTATO_CAPTURE_H
+
+#include "potato-bus.h"
+
+/**
+ * @file    potato-capture.h
+ * @brief   Packet capture and replay
+ */
+
+/** @defgroup capture   Capture and replay API
+ * Capture records every readPacket call made by client (after
+ * TLS decryption) with its result and timestamp. Capture is
+ * attached by pbConnectSocket when client->capture is set, so
+ * it follows reconnects.
+ *
+ * Replay transport feeds captured stream back into a client
+ * either with original timing or as fast as possible. Read
+ * boundaries, timeouts and errors are replayed as captured,
+ * so same code sees exactly same sequence of reads. Data
+ * written by client is discarded. Replay is available on
+ * hosts (USE_UNIX_SOCKETS).
+ *
+ * Capture format (little-endian): "PBCP", 16-bit version,
+ * 16-bit reserved, followed by records of 32-bit microseconds
+ * since previous record, 32-bit signed read result and data
+ * bytes when result is positive.
+ *
+ * Usage:
+ * @code
+ * static PbCapture cap;
+ *
+ * pbCaptureOpen(&cap, "/tmp/broker.cap");
+ * client.capture = &cap;
+ * pbConnect(&client, url, &connectArgs);
+ * @endcode
+ * @{
+ */
+
+#define PB_CAPTURE_MAGIC   "PBCP"
+#define PB_CAPTURE_VERSION 1
+#define PB_CAPTURE_HEADER  8
+#define PB_CAPTURE_RECORD  8
+
+/**
+ * Capture state.
+ */
+typedef struct pbCapture {
+
+  int   (*write)(void* ctx, const void* buf, int len);
+  void* ctx;
+  int   error;                 // set if writing capture failed
+  int64_t last;                // time of previous record
+  int   (*readPacket)(PbClient*, unsigned char*, size_t);
+} PbCapture;
+
+/**
+ * Initialize capture which outputs using given
+ * write function. Writes capture header.
+ */
+int pbCaptureInit(PbCapture* cap, int (*write)(void* ctx, const void* buf, int len), void* ctx);
+
+/**
+ * Wrap client read hook with capture. Called by
+ * pbConnectSocket when client->capture is set.
+ */
+void pbCaptureAttach(PbClient* client);
+
+#ifdef USE_UNIX_SOCKETS
+
+/**
+ * Replay transport state.
+ */
+typedef struct {
+
+  const unsigned char* data;
+  size_t  size;
+  size_t  pos;
+  int     left;                // data left in current record
+  bool    realtime;
+  int64_t due;                 // replay time of current record
+} PbReplay;
+
+/**
+ * Start capture into file.
+ */
+int pbCaptureOpen(PbCapture* cap, const char* path);
+
+/**
+ * Close capture file.
+ */
+int pbCaptureClose(PbCapture* cap);
+
+/**
+ * Load capture file into memory. Returned buffer
+ * must be released with free.
+ */
+unsigned char* pbReplayLoad(const char* path, size_t* size);
+
+/**
+ * Connect client to replay transport. If realtime is set,
+ * reads are delayed to match original timing.
+ */
+int pbReplayStart(PbClient* client, PbReplay* rp, const unsigned char* data, size_t size, bool realtime);
+
+/**
+ * Check if all captured data has been replayed.
+ */
+bool pbReplayEnd(const PbReplay* rp);
+
+#endif
+
+/** @} */
+
+#endif /* _POTATO_CAPTURE_H */
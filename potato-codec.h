@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _POTATO_CODEC_H
+#define _POTATO_CODEC_H
+
+#include "potato-bus.h"
+
+/**
+ * @file    potato-codec.h
+ * @brief   Payload compression for publish and receive
+ */
+
+/** @defgroup codec   Payload codec API
+ * Optional codec stage compresses published messages and
+ * decompresses received ones. Encoded payload starts with
+ * a marker byte, which is codec id for compressed data or
+ * PB_CODEC_NONE if message was sent as is (because it didn't
+ * compress). Publisher and subscribers of a topic must agree
+ * on using codec stage.
+ *
+ * Library contains a small LZ77 compressor (pbLzCodec), which
+ * uses no dynamic memory. Decompression is streaming, so
+ * messages can be decompressed in pieces into small buffers.
+ * @{
+ */
+
+/**
+ * Marker byte for message that is not compressed.
+ */
+#define PB_CODEC_NONE 0
+
+/**
+ * Marker byte for pbLzCodec.
+ */
+#define PB_CODEC_LZ   1
+
+/**
+ * LZ decoder window size. Fixed by compressed format.
+ */
+#define PB_LZ_WINDOW  1024
+
+/**
+ * Number of bits in LZ compressor hash table.
+ * Compressor uses 2 bytes of stack for each entry.
+ */
+#ifndef POTATO_LZ_HASH_BITS
+#define POTATO_LZ_HASH_BITS 8
+#endif
+
+/**
+ * Codec interface.
+ */
+typedef struct pbCodec {
+
+  uint8_t id;                  // marker byte, nonzero
+
+  /**
+   * Compress in to out. Returns length of output or
+   * -1 if it doesn't fit.
+   */
+  int  (*encode)(const uint8_t* in, int inLen, uint8_t* out, int outLen);
+
+  /**
+   * Initialize decoder state.
+   */
+  void (*decodeInit)(void* state);
+
+  /**
+   * Decompress next piece. Consumes input from *in and
+   * produces at most outLen bytes. Returns number of bytes
+   * produced, 0 when there is no more output or -1 on error.
+   */
+  int  (*decode)(void* state, const uint8_t** in, int* inLen, uint8_t* out, int outLen);
+} PbCodec;
+
+/**
+ * LZ decoder state.
+ */
+typedef struct {
+
+  uint8_t  window[PB_LZ_WINDOW];
+  uint32_t total;              // bytes produced so far
+  int      literals;           // literal bytes left in current run
+  int      matchLen;           // match bytes left to copy
+  int      matchOff;
+  int      token;              // match token waiting for offset byte, or -1
+} PbLzDecoder;
+
+/**
+ * Built-in LZ codec. Decoder state is PbLzDecoder.
+ */
+extern const PbCodec pbLzCodec;
+
+/**
+ * Streaming decoder for received message.
+ */
+typedef struct {
+
+  const PbCodec* codec;        // NULL if message is not compressed
+  void*          state;
+  const uint8_t* in;
+  int            inLen;
+  bool           error;
+} PbDecoder;
+
+/**
+ * Compress data with LZ codec.
+ */
+int pbLzCompress(const uint8_t* in, int inLen, uint8_t* out, int outLen);
+
+/**
+ * Decompress data with LZ codec.
+ */
+int pbLzDecompress(PbLzDecoder* dec, const uint8_t** in, int* inLen, uint8_t* out, int outLen);
+
+/**
+ * Write publish packet with message encoded by codec. If message
+ * doesn't get smaller, it is sent uncompressed.
+ */
+int pbWritePublishCodec(PbPacket* pkt, PbPublish* args, const PbCodec* codec);
+
+/**
+ * Start decoding received message. State must be
+ * decoder state storage for codec (PbLzDecoder for pbLzCodec).
+ */
+void pbDecodeStart(PbDecoder* dec, const PbCodec* codec, void* state, const PbPublish* pub);
+
+/**
+ * Get next piece of decoded message. Returns number
+ * of bytes stored to out, 0 at end of message or
+ * PB_ERROR if message is corrupt or encoded with
+ * unknown codec.
+ */
+int pbDecodeNext(PbDecoder* dec, uint8_t* out, int outLen);
+
+/**
+ * Decode whole message into buffer. Returns
+ * length of message, PB_TOOBIG if it doesn't fit or
+ * PB_ERROR.
+ */
+int pbDecodePublish(const PbCodec* codec, void* state, const PbPublish* pub, uint8_t* out, int outLen);
+
+/** @} */
+
+#endif /* _POTATO_CODEC_H */
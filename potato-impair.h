@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _POTATO_IMPAIR_H
+#define _POTATO_IMPAIR_H
+
+#include "potato-bus.h"
+
+/**
+ * @file    potato-impair.h
+ * @brief   Network impairment simulator
+ */
+
+/** @defgroup impair   Network impairment API
+ * For testing client behaviour on bad links, transport
+ * hooks can be wrapped with impairment layer, which adds
+ * latency, limits bandwidth, splits reads into small fragments,
+ * stalls transfer periodically and drops connection after
+ * given amount of data. Stall longer than socket receive
+ * timeout makes reads time out like a silent link would.
+ * Impairment is attached by pbConnectSocket when client->impair
+ * is set.
+ *
+ * Usage:
+ * @code
+ * static PbImpair impair = {
+ *
+ *   .latency   = 300,
+ *   .bandwidth = 2000,
+ *   .maxRead   = 1
+ * };
+ *
+ * client.impair = &impair;
+ * @endcode
+ * @{
+ */
+
+/**
+ * Impairment settings and state.
+ */
+typedef struct pbImpair {
+
+  int      latency;            // milliseconds added to each write
+  int      jitter;             // max random milliseconds added to latency
+  int      bandwidth;          // bytes per second, 0 = unlimited
+  int      maxRead;            // max bytes returned by read, 0 = unlimited
+  int      stallEvery;         // stall after this many bytes, 0 = never
+  int      stallTime;          // stall length, milliseconds
+  long     disconnectAfter;    // drop connection after this many bytes, 0 = never
+  uint32_t seed;               // random seed for jitter
+
+  // State, cleared when attached.
+  long     bytes;              // bytes transferred in this connection
+  long     stallBytes;
+  int      stallLeft;          // milliseconds of stall pending
+  int64_t  debt;               // delay not yet slept, microseconds
+  int      (*writePacket)(PbClient*, const unsigned char*, size_t);
+  int      (*readPacket)(PbClient*, unsigned char*, size_t);
+} PbImpair;
+
+/**
+ * Wrap client transport hooks with impairment layer.
+ * Called by pbConnectSocket when client->impair is set.
+ */
+void pbImpairAttach(PbClient* client);
+
+/** @} */
+
+#endif /* _POTATO_IMPAIR_H */
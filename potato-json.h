@@ -119,7 +119,9 @@ typedef struct jsonContext  {
 JsonNode* jsonParse(JsonContext* ctx, char* json);
 
 /**
- * Get next json node from input string.
+ * Get next json node from input string. Returns NULL
+ * at end of object or array. Malformed input also
+ * ends iteration and makes jsonFailed true.
  * 
  * @sa jsonReset
  */
@@ -221,6 +223,11 @@ void jsonWriteNull(JsonNode* node);
  */
 void jsonWriteInteger(JsonNode* node, int value);
 
+/**
+ * Write json unsigned integer value.
+ */
+void jsonWriteUnsigned(JsonNode* node, unsigned int value);
+
 /**
  * Write json double/float value.
  */
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _POTATO_LATENCY_H
+#define _POTATO_LATENCY_H
+
+#include "potato-bus.h"
+
+/**
+ * @file    potato-latency.h
+ * @brief   Latency histograms
+ */
+
+/** @defgroup latency   Latency histogram API
+ * Client can record latencies of network operations into
+ * fixed size histograms. Buckets grow logarithmically, each power
+ * of two range is split into 2^POTATO_HIST_SUB_BITS linear
+ * sub-buckets, so relative error is bounded while memory use
+ * stays constant. Values are microseconds from pbClock.
+ *
+ * Recording is enabled by pointing client->latency to
+ * a PbLatency structure. Histograms can be read with
+ * pbHistogramSnapshot from another task while client is running.
+ *
+ * Usage:
+ * @code
+ * static PbLatency lat;
+ * PbHistogram snap;
+ *
+ * client.latency = &lat;
+ * ...
+ * pbHistogramSnapshot(&lat.ping, &snap);
+ * printf("ping p99 %u us\n", pbHistogramPercentile(&snap, 99.0));
+ * @endcode
+ * @{
+ */
+
+#ifndef POTATO_HIST_SUB_BITS
+#define POTATO_HIST_SUB_BITS 2
+#endif
+
+#define PB_HIST_SUB     (1 << POTATO_HIST_SUB_BITS)
+#define PB_HIST_BUCKETS ((32 - POTATO_HIST_SUB_BITS + 1) * PB_HIST_SUB)
+
+/**
+ * Log-bucketed histogram of microsecond values.
+ */
+typedef struct {
+
+  volatile uint32_t seq;       // odd while update is in progress
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t buckets[PB_HIST_BUCKETS];
+} PbHistogram;
+
+/**
+ * Latencies recorded by client.
+ */
+typedef struct pbLatency {
+
+  PbHistogram connect;         // socket connect
+  PbHistogram handshake;       // TLS handshake
+  PbHistogram connack;         // CONNECT sent to CONNACK received
+  PbHistogram ping;            // PINGREQ sent to PINGRESP received
+  PbHistogram ack;             // SUBSCRIBE sent to SUBACK received
+  PbHistogram write;           // time blocked writing a packet
+
+  int64_t connackSent;         // pending request timestamps
+  int64_t pingSent;
+  int64_t ackSent;
+} PbLatency;
+
+/**
+ * Clear histogram.
+ */
+void pbHistogramReset(PbHistogram* hist);
+
+/**
+ * Add value to histogram. Only one task may record
+ * into same histogram.
+ */
+void pbHistogramRecord(PbHistogram* hist, uint32_t value);
+
+/**
+ * Take consistent copy of histogram, which may be
+ * concurrently updated by another task.
+ */
+void pbHistogramSnapshot(const PbHistogram* hist, PbHistogram* snap);
+
+/**
+ * Add values of snapshot src into dst.
+ */
+void pbHistogramMerge(PbHistogram* dst, const PbHistogram* src);
+
+/**
+ * Get value at given percentile (0-100). Result is
+ * upper bound of bucket where percentile falls, clamped to
+ * maximum recorded value.
+ */
+uint32_t pbHistogramPercentile(const PbHistogram* hist, double percentile);
+
+/**
+ * Get average of recorded values.
+ */
+uint32_t pbHistogramMean(const PbHistogram* hist);
+
+/**
+ * Clear all client latency histograms.
+ */
+void pbLatencyReset(PbLatency* lat);
+
+/**
+ * Record time elapsed since start (pbClock value).
+ */
+void pbLatencySince(PbHistogram* hist, int64_t start);
+
+/**
+ * Note that packet of given type was sent. Used by client
+ * to start timing of request/response pairs.
+ */
+void pbLatencySent(PbLatency* lat, int type);
+
+/**
+ * Note that packet of given type was received. Records
+ * time since matching request was sent.
+ */
+void pbLatencyReceived(PbLatency* lat, int type);
+
+/** @} */
+
+#endif /* _POTATO_LATENCY_H */
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _POTATO_LOCAL_H
+#define _POTATO_LOCAL_H
+
+#include "potato-bus.h"
+#include "potato-port.h"
+
+/**
+ * @file    potato-local.h
+ * @brief   In-process publish/subscribe bus
+ */
+
+/** @defgroup local   Local bus API
+ * Tasks in same firmware can exchange messages through local
+ * bus instead of making a round trip through broker. Handlers
+ * are registered for topic filters (+ and # wildcards work like
+ * in MQTT). pbLocalPublish calls each matching handler directly
+ * with publisher's PbPublish, so message is not copied.
+ * Handler must copy data it needs after it returns.
+ *
+ * If client->local is set, pbPublish delivers message to local
+ * handlers first and then forwards it to broker depending on
+ * bus->forward. Local delivery happens before compression by
+ * client->codec. Note that with PB_LOCAL_FORWARD_ALL a client
+ * that has also subscribed to topic from broker gets message twice.
+ *
+ * Handlers are called with bus mutex held, so publishes from
+ * different tasks are serialized and handlers should be short.
+ * Handler may publish or change subscriptions, as mutex is recursive.
+ *
+ * Usage:
+ * @code
+ * static PbLocalBus bus;
+ *
+ * static void onTemp(void* ctx, const PbPublish* pub)
+ * {
+ *   ...
+ * }
+ *
+ * pbLocalInit(&bus, PB_LOCAL_FORWARD_UNMATCHED);
+ * pbLocalSubscribe(&bus, "sensor/+/temp", onTemp, NULL);
+ * client.local = &bus;
+ * @endcode
+ * @{
+ */
+
+/**
+ * Max number of local subscriptions.
+ */
+#ifndef POTATO_LOCAL_SUBS
+#define POTATO_LOCAL_SUBS 16
+#endif
+
+#define PB_LOCAL_FORWARD_NONE      0   // deliver only locally
+#define PB_LOCAL_FORWARD_ALL       1   // deliver locally and send to broker
+#define PB_LOCAL_FORWARD_UNMATCHED 2   // send to broker if there was no local subscriber
+
+/**
+ * Handler for locally published message.
+ */
+typedef void (*PbLocalHandler)(void* ctx, const PbPublish* pub);
+
+/**
+ * Local subscription.
+ */
+typedef struct {
+
+  const char*    filter;       // NULL = free slot
+  PbLocalHandler handler;
+  void*          ctx;
+} PbLocalSub;
+
+/**
+ * Local bus.
+ */
+typedef struct pbLocalBus {
+
+  PbMutex    mutex;
+  int        forward;          // PB_LOCAL_FORWARD_*
+  int        count;            // slots in use, including freed ones
+  PbLocalSub subs[POTATO_LOCAL_SUBS];
+
+  // Counters.
+  uint32_t   published;        // messages published to bus
+  uint32_t   delivered;        // handler calls
+  uint32_t   forwarded;        // messages sent to broker by pbPublish
+} PbLocalBus;
+
+/**
+ * Initialize local bus.
+ */
+int pbLocalInit(PbLocalBus* bus, int forward);
+
+/**
+ * Register handler for topic filter. Filter
+ * string is not copied, so it must stay valid
+ * while subscription is active. Returns PB_ERROR if
+ * there are no free subscription slots.
+ */
+int pbLocalSubscribe(PbLocalBus* bus, const char* filter, PbLocalHandler handler, void* ctx);
+
+/**
+ * Remove subscription registered with same filter,
+ * handler and context.
+ */
+int pbLocalUnsubscribe(PbLocalBus* bus, const char* filter, PbLocalHandler handler, void* ctx);
+
+/**
+ * Deliver message to matching local handlers.
+ * Returns number of handlers called.
+ */
+int pbLocalPublish(PbLocalBus* bus, const PbPublish* pub);
+
+/** @} */
+
+#endif /* _POTATO_LOCAL_H */
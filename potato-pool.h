@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _POTATO_POOL_H
+#define _POTATO_POOL_H
+
+#include "potato-bus.h"
+#include "potato-port.h"
+
+/**
+ * @file    potato-pool.h
+ * @brief   Leased receive buffers
+ */
+
+/** @defgroup pool   Leased receive buffer API
+ * Normally packets are received into client->packet, which is
+ * overwritten by next pbEvent. If client has a buffer pool,
+ * each packet is received into a buffer from the pool instead.
+ * Published messages can be taken out of client as reference counted
+ * leases, which keep the buffer until last reference is released. This
+ * allows passing messages to other tasks without copying them.
+ *
+ * Usage:
+ * @code
+ * static PbLease leases[8];
+ * static PbPool  pool;
+ *
+ * pbPoolInit(&pool, leases, 8);
+ * client.pool = &pool;
+ * ...
+ * if (pbEvent(&client) == PB_MQ_PUBLISH) {
+ *
+ *   lease = pbLeasePublish(&client, &pub);
+ *   // pass pub & lease to worker, which calls pbLeaseRelease
+ * }
+ * @endcode
+ * @{
+ */
+
+/**
+ * Leased packet buffer.
+ */
+typedef struct pbLease {
+
+  PbPacket        packet;
+  int             refs;
+  struct pbPool*  pool;
+  struct pbLease* next;
+} PbLease;
+
+/**
+ * Pool of packet buffers.
+ */
+typedef struct pbPool {
+
+  PbMutex  mutex;
+  PbLease* free;
+  int      available;
+} PbPool;
+
+/**
+ * Initialize pool using given array of buffers.
+ */
+int pbPoolInit(PbPool* pool, PbLease* leases, int count);
+
+/**
+ * Get buffer from pool. Returns NULL if pool is empty.
+ */
+PbLease* pbPoolGet(PbPool* pool);
+
+/**
+ * Take lease of last received publish packet and read it.
+ * Message data in pub points to leased buffer, which stays
+ * valid until lease is released. Client continues with a new
+ * buffer from pool. Returns NULL if last packet is not
+ * in pool buffer (pool was empty); pub is still filled, but
+ * it is valid only until next pbEvent.
+ */
+PbLease* pbLeasePublish(PbClient* client, PbPublish* pub);
+
+/**
+ * Add reference to lease.
+ */
+void pbLeaseRetain(PbLease* lease);
+
+/**
+ * Drop reference to lease. Buffer returns
+ * to pool when last reference is dropped.
+ */
+void pbLeaseRelease(PbLease* lease);
+
+/** @} */
+
+#endif /* _POTATO_POOL_H */
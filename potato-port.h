@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _POTATO_PORT_H
+#define _POTATO_PORT_H
+
+/**
+ * @file    potato-port.h
+ * @brief   Operating system and network services used by potato-bus
+ */
+
+#ifdef USE_UNIX_SOCKETS
+
+#include <pthread.h>
+#include <sys/socket.h>
+
+typedef pthread_mutex_t PbMutex;
+
+#else
+
+#include <picoos.h>
+#include <picoos-lwip.h>
+
+typedef POSMUTEX_t PbMutex;
+
+#endif
+
+/**
+ * Priority of tasks created by library.
+ */
+#ifndef POTATO_TASK_PRIO
+#define POTATO_TASK_PRIO 1
+#endif
+
+/**
+ * Stack size of tasks created by library.
+ */
+#ifndef POTATO_TASK_STACK
+#define POTATO_TASK_STACK 2000
+#endif
+
+/**
+ * Number of hosts in resolved endpoint cache.
+ * Zero disables the cache.
+ */
+#ifndef POTATO_ENDPOINT_CACHE
+#define POTATO_ENDPOINT_CACHE 0
+#endif
+
+/**
+ * Time in seconds how long resolved addresses
+ * are valid in endpoint cache.
+ */
+#ifndef POTATO_ENDPOINT_TTL
+#define POTATO_ENDPOINT_TTL 300
+#endif
+
+/**
+ * Max length of host name in endpoint cache.
+ */
+#ifndef POTATO_ENDPOINT_HOST
+#define POTATO_ENDPOINT_HOST 64
+#endif
+
+/**
+ * Resolved socket address.
+ */
+typedef struct {
+
+  int                     family;
+  socklen_t               len;
+  struct sockaddr_storage addr;
+} PbAddress;
+
+/**
+ * @ingroup common
+ * @{
+ */
+
+/**
+ * Get monotonic clock in microseconds.
+ */
+int64_t pbClock(void);
+
+/**
+ * Sleep given number of milliseconds.
+ */
+void pbSleep(int ms);
+
+/**
+ * Create a new task (thread) that runs given function.
+ */
+int pbTaskCreate(void (*func)(void*), void* arg, const char* name);
+
+/**
+ * Initialize mutex. Mutexes are recursive, same task
+ * may lock them several times.
+ */
+int pbMutexInit(PbMutex* mutex);
+
+/**
+ * Lock mutex.
+ */
+void pbMutexLock(PbMutex* mutex);
+
+/**
+ * Unlock mutex.
+ */
+void pbMutexUnlock(PbMutex* mutex);
+
+/**
+ * Destroy mutex. It must not be locked.
+ */
+void pbMutexDestroy(PbMutex* mutex);
+
+/**
+ * Resolve host and port to socket addresses. Addresses
+ * are ordered so that address families alternate (RFC 8305).
+ * Returns number of addresses or -1 if resolving failed.
+ */
+int pbResolve(const char* host, const char* port, PbAddress* addrs, int max);
+
+/**
+ * Initialize endpoint cache and start its refresh task.
+ * Must be called once at startup before tasks that
+ * connect are started. Until then pbEndpointResolve
+ * resolves without cache.
+ */
+int pbEndpointInit(void);
+
+/**
+ * Resolve host and port in url using endpoint cache.
+ * If host is not in cache, it is resolved immediately.
+ * Cached entries are refreshed by background task before
+ * they expire. If refresh fails, old addresses are returned.
+ * Cache is keyed by host and port, url itself is tokenized
+ * by caller. Without cache this is same as pbResolve.
+ */
+int pbEndpointResolve(const PbUrl* url, PbAddress* addrs, int max);
+
+/**
+ * Remove all entries from endpoint cache.
+ */
+void pbEndpointFlush(void);
+
+/** @} */
+
+#endif /* _POTATO_PORT_H */
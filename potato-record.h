@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _POTATO_RECORD_H
+#define _POTATO_RECORD_H
+
+#include "potato-bus.h"
+
+/**
+ * @file    potato-record.h
+ * @brief   Packet flight recorder
+ */
+
+/** @defgroup record   Flight recorder API
+ * Flight recorder keeps metadata of last POTATO_RECORD_EVENTS
+ * packets and errors in a ring buffer. Recording an event
+ * is a single atomic increment and a 16-byte store, so it can be
+ * left enabled in production. Several clients (for example
+ * shards) may share one recorder.
+ *
+ * Ring can be dumped on demand or from error callback
+ * into compact little-endian binary format, which is
+ * decoded offline with tools/pbrecord.
+ *
+ * Usage:
+ * @code
+ * static PbRecorder rec;
+ *
+ * static void onError(PbRecorder* rec, int error)
+ * {
+ *   pbRecordDumpFile(rec, "/tmp/potato.rec");
+ * }
+ *
+ * rec.onError     = onError;
+ * client.recorder = &rec;
+ * @endcode
+ * @{
+ */
+
+#ifndef POTATO_RECORD_EVENTS
+#define POTATO_RECORD_EVENTS 256
+#endif
+
+#if (POTATO_RECORD_EVENTS & (POTATO_RECORD_EVENTS - 1)) != 0
+#error POTATO_RECORD_EVENTS must be power of two
+#endif
+
+#define PB_RECORD_MAGIC   "PBFR"
+#define PB_RECORD_VERSION 1
+
+#define PB_RECORD_TX      0    // packet sent
+#define PB_RECORD_RX      1    // packet received
+#define PB_RECORD_ERROR   2    // error, len contains error code
+
+/**
+ * Single recorded event.
+ */
+typedef struct {
+
+  uint32_t time;               // low 32 bits of pbClock
+  uint8_t  dir;
+  uint8_t  header;             // first byte of fixed header
+  uint16_t packetId;
+  uint32_t len;
+  uint32_t topicHash;          // hash of PUBLISH topic
+} PbRecordEvent;
+
+/**
+ * Event ring.
+ */
+typedef struct pbRecorder {
+
+  uint32_t      head;          // number of events recorded
+  PbRecordEvent events[POTATO_RECORD_EVENTS];
+
+  void (*onError)(struct pbRecorder*, int error);
+} PbRecorder;
+
+/**
+ * Function used to output dump.
+ */
+typedef int (*PbRecordWriter)(void* ctx, const void* buf, int len);
+
+/**
+ * Record packet. Called by client.
+ */
+void pbRecordPacket(PbRecorder* rec, int dir, const unsigned char* buf, int len);
+
+/**
+ * Record error and call onError callback, if set. Timeouts
+ * are recorded without calling callback. Read timeouts of
+ * pbEvent are normal on idle connection and not recorded,
+ * otherwise they would push real errors out of ring.
+ */
+void pbRecordError(PbRecorder* rec, int error);
+
+/**
+ * Write dump of recorded events, oldest first. Events
+ * recorded while dump is in progress may be inconsistent.
+ */
+int pbRecordDump(PbRecorder* rec, PbRecordWriter writer, void* ctx);
+
+#ifdef USE_UNIX_SOCKETS
+
+/**
+ * Write dump into file.
+ */
+int pbRecordDumpFile(PbRecorder* rec, const char* path);
+
+#endif
+
+/** @} */
+
+#endif /* _POTATO_RECORD_H */
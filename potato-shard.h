@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _POTATO_SHARD_H
+#define _POTATO_SHARD_H
+
+#include "potato-bus.h"
+#include "potato-port.h"
+
+/**
+ * @file    potato-shard.h
+ * @brief   Sharded MQTT publisher
+ */
+
+/** @defgroup shard   Sharded publisher API
+ * Sharded publisher opens several connections to broker
+ * and spreads published messages over them by topic.
+ * Messages to same topic always use same connection,
+ * so their order is kept. Each connection is served
+ * by its own task, which handles keepalive and reconnects.
+ *
+ * Connection reader task and publishers use same connection
+ * simultaneously. mbedtls doesn't allow that, so TLS
+ * connections must be offloaded to kernel (PbSocketOptions.ktls).
+ * pbShardStart refuses TLS without ktls option and connections
+ * where kernel did not accept the cipher are dropped.
+ * All shards use same sslConf, so their TLS handshakes
+ * are done one at a time.
+ * @{
+ */
+
+/**
+ * Max number of shards.
+ */
+#ifndef POTATO_SHARDS
+#define POTATO_SHARDS 4
+#endif
+
+/**
+ * Max length of shard client id.
+ */
+#ifndef POTATO_SHARD_ID
+#define POTATO_SHARD_ID 32
+#endif
+
+struct pbShardedClient;
+
+/**
+ * Single connection of sharded publisher.
+ */
+typedef struct {
+
+  PbClient client;
+  PbPacket out;                // packet buffer for publish and ping
+  PbMutex  mutex;              // serializes writes to connection
+  char     clientId[POTATO_SHARD_ID];
+  bool     connected;
+  bool     running;            // shard task has not exited yet
+  int      reconnects;
+  struct pbShardedClient* owner;
+} PbShard;
+
+/**
+ * Sharded publisher handle.
+ */
+typedef struct pbShardedClient {
+
+  char       url[128];
+  PbConnect  connect;
+  int        shardCount;
+  int        retryDelay;       // milliseconds between reconnect attempts
+  volatile bool stop;          // set by pbShardStop
+  PbMutex    connectMutex;     // serializes TLS handshakes using shared sslConf
+
+  /**
+   * Called by shard task when a message arrives from broker
+   * to one of the connections. Optional.
+   */
+  void (*received)(struct pbShardedClient*, int shard, PbPublish* pub);
+
+  PbShard    shards[POTATO_SHARDS];
+} PbShardedClient;
+
+/**
+ * Start sharded publisher. Opens shards connections to broker
+ * using arg as template. Client id of each connection is
+ * arg->clientId with shard number appended ("id-0", "id-1", ...).
+ * TLS (arg->sslConf) is accepted only together with
+ * arg->sockOpts->ktls, otherwise PB_ERROR is returned.
+ */
+int pbShardStart(PbShardedClient* sc, const char* url, const PbConnect* arg, int shards);
+
+/**
+ * Stop sharded publisher. Disconnects all shards and waits
+ * until shard tasks have exited. pbShardStart calls this
+ * itself if it fails after starting some of the tasks.
+ * Sharded client must not be used after this without
+ * starting it again.
+ */
+void pbShardStop(PbShardedClient* sc);
+
+/**
+ * Get shard number used for topic.
+ */
+int pbShardOf(PbShardedClient* sc, const char* topic);
+
+/**
+ * Publish message using shard selected by topic. Returns
+ * PB_NETWORK if that shard is not connected at the moment.
+ * Can be called from several tasks simultaneously.
+ */
+int pbShardPublish(PbShardedClient* sc, PbPublish* pub);
+
+/**
+ * Check if shard is connected.
+ */
+bool pbShardConnected(PbShardedClient* sc, int shard);
+
+/** @} */
+
+#endif /* _POTATO_SHARD_H */
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _POTATO_SHM_H
+#define _POTATO_SHM_H
+
+#include "potato-bus.h"
+
+/**
+ * @file    potato-shm.h
+ * @brief   Shared memory transport
+ */
+
+/** @defgroup shm   Shared memory transport API
+ * Processes on same Linux host can exchange messages through
+ * a POSIX shared memory segment instead of a broker. Client
+ * connects with shm://name url and uses normal pbPublish,
+ * pbSubscribe and pbEvent calls. Transport answers CONNECT,
+ * SUBSCRIBE, UNSUBSCRIBE and PINGREQ itself.
+ *
+ * Segment contains a ring of PUBLISH packets, which all
+ * processes append to and read from. Producers reserve space
+ * with compare-and-swap and stamp record with its position
+ * when it is complete, so they don't wait for each other.
+ * Each client has its own read cursor and filters records
+ * by topic. Records are tagged with topic hash, so records
+ * not matching filters without wildcards are skipped without
+ * copying them. Consumer that falls more than ring size behind
+ * loses oldest records (counted in shm->dropped). Messages
+ * that don't fit into ring are dropped by publisher and
+ * counted in client->stats->tooBig. Waiting
+ * consumers sleep on futex; producers make the wake up system
+ * call only when somebody is waiting, so there are no system
+ * calls per message when consumers keep up.
+ *
+ * Read timeout is derived from keepalive like with sockets.
+ * Note that producer which dies between reserving and stamping
+ * a record stalls consumers at that record.
+ *
+ * Usage:
+ * @code
+ * static PbShm shm;
+ *
+ * client.shm = &shm;
+ * pbConnect(&client, "shm://sensors", &connectArgs);
+ * @endcode
+ * @{
+ */
+
+#ifndef POTATO_SHM
+#if defined(USE_UNIX_SOCKETS) && defined(__linux__)
+#define POTATO_SHM 1
+#else
+#define POTATO_SHM 0
+#endif
+#endif
+
+/**
+ * Size of ring data area in new segments.
+ * Must be power of two.
+ */
+#ifndef POTATO_SHM_SIZE
+#define POTATO_SHM_SIZE (1024 * 1024)
+#endif
+
+#if (POTATO_SHM_SIZE & (POTATO_SHM_SIZE - 1)) != 0
+#error POTATO_SHM_SIZE must be power of two
+#endif
+
+/**
+ * Max number of subscriptions per client.
+ */
+#ifndef POTATO_SHM_FILTERS
+#define POTATO_SHM_FILTERS 8
+#endif
+
+/**
+ * Max length of subscription filter.
+ */
+#ifndef POTATO_SHM_FILTER_LEN
+#define POTATO_SHM_FILTER_LEN 64
+#endif
+
+#define PB_SHM_MAGIC   0x50425348 // "PBSH"
+#define PB_SHM_VERSION 1
+
+/**
+ * Shared segment header. Ring data follows it.
+ */
+typedef struct pbShmRing {
+
+  uint32_t magic;              // set last by creator
+  uint32_t version;
+  uint32_t size;               // data area size
+  uint32_t recordAlign;
+  uint64_t reserve;            // stream position reserved by producers
+  uint32_t wake;               // futex word, bumped when waking consumers
+  uint32_t waiters;            // consumers sleeping on wake
+  uint8_t  pad[32];
+} PbShmRing;
+
+/**
+ * Record header in ring. Record is PUBLISH
+ * packet padded to 16 bytes.
+ */
+typedef struct {
+
+  uint64_t pos;                // stream position, written last
+  uint32_t len;                // packet length, 0 = padding to end of ring
+  uint32_t topicHash;          // pbHash of topic
+} PbShmRecord;
+
+/**
+ * Subscription filter.
+ */
+typedef struct {
+
+  char     filter[POTATO_SHM_FILTER_LEN];
+  uint32_t hash;               // topic hash if filter has no wildcards
+  bool     wild;
+} PbShmFilter;
+
+/**
+ * Client state for shared memory transport.
+ */
+typedef struct pbShm {
+
+  PbShmRing*    ring;
+  size_t        mapSize;
+  uint64_t      cursor;        // next record to read
+  int           timeout;       // read timeout in milliseconds, 0 = none
+  int           filterCount;
+  PbShmFilter   filters[POTATO_SHM_FILTERS];
+  unsigned char reply[32];     // responses generated by transport
+  int           replyLen;
+  unsigned char rx[POTATO_BUFSIZE]; // packet being read
+  int           rxPos;
+  int           rxLen;
+  uint32_t      dropped;       // records lost because of overrun
+} PbShm;
+
+#if POTATO_SHM
+
+/**
+ * Attach client to shared memory segment named
+ * by url host, creating it if necessary. Called by
+ * pbConnectSocket for shm:// urls.
+ */
+int pbShmAttach(PbClient* client, const PbUrl* url);
+
+/**
+ * Remove shared memory segment. Processes having it
+ * mapped can still use it.
+ */
+int pbShmUnlink(const char* name);
+
+#endif
+
+/** @} */
+
+#endif /* _POTATO_SHM_H */
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _POTATO_STATS_H
+#define _POTATO_STATS_H
+
+#include "potato-bus.h"
+
+/**
+ * @file    potato-stats.h
+ * @brief   Client statistics
+ */
+
+/** @defgroup stats   Client statistics API
+ * Client counts packets and bytes per packet type, transport
+ * calls and error events into PbStats structure pointed by
+ * client->stats. Messages per topic are counted for most active
+ * topics using space-saving algorithm: when table is full, least
+ * active topic is replaced and new topic inherits its count
+ * (which is remembered as error bound).
+ *
+ * Counters are updated only by task running the client, without
+ * locking. Other tasks may read them, but snapshot is not
+ * atomic across counters. Counters wrap at 2^32.
+ *
+ * If stats->topic is set, pbEvent publishes statistics
+ * as JSON to that topic every stats->interval milliseconds.
+ * Failure to publish doesn't stop pbEvent, it is only
+ * recorded into client->recorder.
+ *
+ * Usage:
+ * @code
+ * static PbStats stats;
+ *
+ * stats.topic    = "device/42/stats";
+ * stats.interval = 60000;
+ * client.stats   = &stats;
+ * @endcode
+ * @{
+ */
+
+#ifndef POTATO_STATS_TOPICS
+#define POTATO_STATS_TOPICS 8
+#endif
+
+#ifndef POTATO_STATS_TOPIC_LEN
+#define POTATO_STATS_TOPIC_LEN 32
+#endif
+
+/**
+ * Packet and byte counter.
+ */
+typedef struct {
+
+  uint32_t packets;
+  uint32_t bytes;
+} PbCounter;
+
+/**
+ * Message counts for single topic.
+ */
+typedef struct {
+
+  uint32_t hash;
+  uint32_t messages;
+  uint32_t bytes;
+  uint32_t error;              // messages may be overcounted by this much
+  char     topic[POTATO_STATS_TOPIC_LEN];
+} PbTopicStats;
+
+/**
+ * Client statistics.
+ */
+typedef struct pbStats {
+
+  PbCounter sent[16];          // indexed by packet type
+  PbCounter received[16];
+  uint32_t  reads;             // transport read calls
+  uint32_t  writes;            // transport write calls
+  uint32_t  partialReads;      // packet body needed more than one read
+  uint32_t  connects;
+  uint32_t  reconnects;
+  uint32_t  tooBig;
+  uint32_t  timeouts;
+  PbTopicStats topics[POTATO_STATS_TOPICS];
+
+  const char* topic;           // topic for periodic publish, optional
+  int         interval;        // publish interval, milliseconds
+  int64_t     lastPublish;
+} PbStats;
+
+/**
+ * Clear counters. Publish settings are kept.
+ */
+void pbStatsReset(PbStats* stats);
+
+/**
+ * Count packet sent or received. Called by client.
+ */
+void pbStatsPacket(PbStats* stats, bool sent, const unsigned char* buf, int len);
+
+/**
+ * Write statistics as JSON into buffer.
+ * Returns length of JSON or PB_TOOBIG if it didn't fit.
+ */
+int pbStatsJson(const PbStats* stats, char* buf, int size);
+
+/**
+ * Publish statistics to stats->topic. JSON is written
+ * directly into client packet buffer, so it must fit
+ * into POTATO_BUFSIZE together with topic. PB_TOOBIG
+ * is returned and counted if it doesn't. Message is sent
+ * straight to broker, without codec or local bus.
+ */
+int pbStatsPublish(PbClient* client);
+
+/**
+ * Publish statistics if interval has elapsed. Called by pbEvent.
+ */
+int pbStatsPoll(PbClient* client);
+
+/** @} */
+
+#endif /* _POTATO_STATS_H */
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _POTATO_TIMER_H
+#define _POTATO_TIMER_H
+
+#include "potato-bus.h"
+
+/**
+ * @file    potato-timer.h
+ * @brief   Hierarchical timer wheel
+ */
+
+/** @defgroup timer   Timer wheel API
+ * Timer wheel keeps deadlines of many connections with
+ * O(1) start and cancel. Timers are embedded in structures
+ * that use them, so no memory is allocated. Wheel has
+ * POTATO_TIMER_LEVELS levels of 64 slots, each level
+ * covering 64 times longer period than previous one.
+ * Timers are moved to lower levels when their slot is reached.
+ *
+ * Wheel reads monotonic clock once in pbTimerWheelRun, which
+ * fires expired timers. Timers are started relative to that
+ * time, so wheel should be run from event loop before waiting
+ * and after waking up. pbTimerWheelNext tells how long loop
+ * may sleep. Wheel is not locked, so it must be used by single
+ * task only.
+ *
+ * If client->timers is set, client uses it for keepalive:
+ * PINGREQ is sent by pbEvent when nothing has been sent
+ * for keepalive period and connection is closed if there is
+ * no response during next period. Several clients in same
+ * task can share a wheel. Keepalive timers only set flags
+ * in client, so whichever client runs the wheel, each client
+ * sends its ping and closes its connection in its own pbEvent.
+ *
+ * Usage:
+ * @code
+ * static PbTimerWheel wheel;
+ * static PbTimer      timer;
+ *
+ * pbTimerWheelInit(&wheel);
+ * pbTimerInit(&timer, onTimeout, ctx);
+ * pbTimerStart(&wheel, &timer, 5000);
+ * while (true) {
+ *
+ *   wait for events, at most pbTimerWheelNext(&wheel) ms
+ *   pbTimerWheelRun(&wheel);
+ * }
+ * @endcode
+ * @{
+ */
+
+/**
+ * Length of timer tick in microseconds.
+ */
+#ifndef POTATO_TIMER_TICK
+#define POTATO_TIMER_TICK 1000
+#endif
+
+/**
+ * Number of wheel levels. With 1 ms tick,
+ * 4 levels cover 4.6 hours. Longer timers are
+ * cascaded from top level until they expire.
+ */
+#ifndef POTATO_TIMER_LEVELS
+#define POTATO_TIMER_LEVELS 4
+#endif
+
+#define PB_TIMER_BITS  6
+#define PB_TIMER_SLOTS (1 << PB_TIMER_BITS)
+
+/**
+ * Timer wheel.
+ */
+typedef struct pbTimerWheel {
+
+  int64_t  start;              // pbClock at tick 0
+  uint64_t now;                // current tick
+  int      count;              // pending timers
+  PbTimer* slots[POTATO_TIMER_LEVELS][PB_TIMER_SLOTS];
+} PbTimerWheel;
+
+/**
+ * Initialize wheel.
+ */
+void pbTimerWheelInit(PbTimerWheel* wheel);
+
+/**
+ * Advance wheel to current time and call functions
+ * of expired timers. Timer function may start and cancel
+ * timers. Returns number of expired timers.
+ */
+int pbTimerWheelRun(PbTimerWheel* wheel);
+
+/**
+ * Get milliseconds until next timer may expire, or -1
+ * if no timers are pending. Result can be shorter than
+ * actual time for timers on higher levels.
+ */
+int pbTimerWheelNext(PbTimerWheel* wheel);
+
+/**
+ * Initialize timer with function called when it expires.
+ */
+void pbTimerInit(PbTimer* timer, void (*func)(void* ctx), void* ctx);
+
+/**
+ * Start timer to expire after ms milliseconds
+ * from time wheel was last run. If timer is already
+ * pending, it is restarted.
+ */
+void pbTimerStart(PbTimerWheel* wheel, PbTimer* timer, int ms);
+
+/**
+ * Cancel pending timer. Does nothing if timer is
+ * not pending.
+ */
+void pbTimerCancel(PbTimerWheel* wheel, PbTimer* timer);
+
+/**
+ * Check if timer is pending.
+ */
+bool pbTimerPending(const PbTimer* timer);
+
+/** @} */
+
+#endif /* _POTATO_TIMER_H */
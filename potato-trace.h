@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _POTATO_TRACE_H
+#define _POTATO_TRACE_H
+
+#include "potato-cfg.h"
+
+/**
+ * @file    potato-trace.h
+ * @brief   Static tracepoints
+ */
+
+/** @defgroup trace   Static tracepoints
+ * If POTATO_USDT is set to 1, library contains USDT
+ * (sys/sdt.h) probes under provider "potato". Probes are
+ * nops until a tracer like bpftrace or perf attaches to them.
+ * By default they are compiled out.
+ *
+ * Probes and their arguments:
+ * - write_start(client, type, len)
+ * - write_done(client, type, len, result)
+ * - read_start(client, header byte)
+ * - read_done(client, type, len)
+ * - connect_start(client, host, port)
+ * - connect_done(client, result)
+ * - mqtt_connected(client, result)
+ * - http_header_start(client)
+ * - http_header_done(client, result)
+ * - http_body_done(client, result)
+ * - json_parse_start(ctx, json)
+ * - json_parse_done(ctx, root)
+ *
+ * Example bpftrace scripts are in tools/bpftrace.
+ * @{
+ */
+
+#ifndef POTATO_USDT
+#define POTATO_USDT 0
+#endif
+
+#if POTATO_USDT
+
+#include <sys/sdt.h>
+
+#define PB_TRACE1(name, a)          DTRACE_PROBE1(potato, name, a)
+#define PB_TRACE2(name, a, b)       DTRACE_PROBE2(potato, name, a, b)
+#define PB_TRACE3(name, a, b, c)    DTRACE_PROBE3(potato, name, a, b, c)
+#define PB_TRACE4(name, a, b, c, d) DTRACE_PROBE4(potato, name, a, b, c, d)
+
+#else
+
+#define PB_TRACE1(name, a)
+#define PB_TRACE2(name, a, b)
+#define PB_TRACE3(name, a, b, c)
+#define PB_TRACE4(name, a, b, c, d)
+
+#endif
+
+/** @} */
+
+#endif /* _POTATO_TRACE_H */
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef USE_UNIX_SOCKETS
+#include <stdio.h>
+#endif
+
+#include "potato-record.h"
+#include "potato-port.h"
+
+#define DUMP_CHUNK 16
+
+static int packetId(const unsigned char* buf, int len)
+{
+  int type = buf[0] >> 4;
+  int pos;
+  int topicLen;
+  const unsigned char* topic;
+
+  if (type == PB_MQ_PUBLISH) {
+
+    // Packet id is present only with QoS > 0.
+    topicLen = pbPublishTopic(buf, len, &topic);
+    if (topicLen < 0 || (buf[0] & 0x6) == 0)
+      return 0;
+
+    pos = topic - buf + topicLen;
+  }
+  else if (type >= PB_MQ_PUBACK && type <= PB_MQ_UNSUBACK) {
+
+    pos = 1;
+    while (pos < len && (buf[pos++] & 0x80))
+      ;
+  }
+  else
+    return 0;
+
+  if (pos + 2 > len)
+    return 0;
+
+  return (buf[pos] << 8) | buf[pos + 1];
+}
+
+static PbRecordEvent* nextEvent(PbRecorder* rec)
+{
+  uint32_t idx = __atomic_fetch_add(&rec->head, 1, __ATOMIC_RELAXED);
+
+  return &rec->events[idx & (POTATO_RECORD_EVENTS - 1)];
+}
+
+void pbRecordPacket(PbRecorder* rec, int dir, const unsigned char* buf, int len)
+{
+  PbRecordEvent* ev;
+  const unsigned char* topic;
+  int topicLen;
+
+  if (len < 2)
+    return;
+
+  ev = nextEvent(rec);
+  ev->time      = (uint32_t)pbClock();
+  ev->dir       = dir;
+  ev->header    = buf[0];
+  ev->packetId  = packetId(buf, len);
+  ev->len       = len;
+  ev->topicHash = 0;
+
+  topicLen = pbPublishTopic(buf, len, &topic);
+  if (topicLen >= 0)
+    ev->topicHash = pbHash(PB_HASH_INIT, topic, topicLen);
+}
+
+void pbRecordError(PbRecorder* rec, int error)
+{
+  PbRecordEvent* ev;
+
+  ev = nextEvent(rec);
+  ev->time      = (uint32_t)pbClock();
+  ev->dir       = PB_RECORD_ERROR;
+  ev->header    = 0;
+  ev->packetId  = 0;
+  ev->len       = (uint32_t)error;
+  ev->topicHash = 0;
+
+  if (error != PB_TIMEOUT && rec->onError != NULL)
+    rec->onError(rec, error);
+}
+
+static unsigned char* put16(unsigned char* ptr, uint16_t value)
+{
+  *ptr++ = value;
+  *ptr++ = value >> 8;
+  return ptr;
+}
+
+static unsigned char* put32(unsigned char* ptr, uint32_t value)
+{
+  ptr = put16(ptr, value);
+  return put16(ptr, value >> 16);
+}
+
+int pbRecordDump(PbRecorder* rec, PbRecordWriter writer, void* ctx)
+{
+  unsigned char  buf[DUMP_CHUNK * sizeof(PbRecordEvent)];
+  unsigned char* ptr;
+  uint32_t       head;
+  uint32_t       count;
+  uint32_t       i;
+  int64_t        now;
+  const PbRecordEvent* ev;
+
+  head  = __atomic_load_n(&rec->head, __ATOMIC_ACQUIRE);
+  count = head < POTATO_RECORD_EVENTS ? head : POTATO_RECORD_EVENTS;
+  now   = pbClock();
+
+  // File header: magic, version, event size, event count,
+  // number of overwritten events and full clock at dump time.
+  memcpy(buf, PB_RECORD_MAGIC, 4);
+  ptr = put16(buf + 4, PB_RECORD_VERSION);
+  ptr = put16(ptr, sizeof(PbRecordEvent));
+  ptr = put32(ptr, count);
+  ptr = put32(ptr, head - count);
+  ptr = put32(ptr, (uint32_t)now);
+  ptr = put32(ptr, (uint32_t)(now >> 32));
+
+  if (writer(ctx, buf, ptr - buf) < 0)
+    return PB_ERROR;
+
+  ptr = buf;
+  for (i = head - count; i != head; i++) {
+
+    ev  = &rec->events[i & (POTATO_RECORD_EVENTS - 1)];
+    ptr = put32(ptr, ev->time);
+    *ptr++ = ev->dir;
+    *ptr++ = ev->header;
+    ptr = put16(ptr, ev->packetId);
+    ptr = put32(ptr, ev->len);
+    ptr = put32(ptr, ev->topicHash);
+
+    if (ptr == buf + sizeof(buf) || i + 1 == head) {
+
+      if (writer(ctx, buf, ptr - buf) < 0)
+        return PB_ERROR;
+
+      ptr = buf;
+    }
+  }
+
+  return count;
+}
+
+#ifdef USE_UNIX_SOCKETS
+
+static int fileWriter(void* ctx, const void* buf, int len)
+{
+  if (fwrite(buf, 1, len, (FILE*)ctx) != (size_t)len)
+    return -1;
+
+  return len;
+}
+
+int pbRecordDumpFile(PbRecorder* rec, const char* path)
+{
+  FILE* f;
+  int   st;
+
+  f = fopen(path, "wb");
+  if (f == NULL)
+    return PB_ERROR;
+
+  st = pbRecordDump(rec, fileWriter, f);
+  if (fclose(f) != 0)
+    st = PB_ERROR;
+
+  return st;
+}
+
+#endif
@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#ifdef USE_UNIX_SOCKETS
+
+#include <sys/socket.h>
+#include <netdb.h>
+#include <netinet/in.h>
+
+#else
+
+#include <picoos.h>
+#include <picoos-lwip.h>
+
+#endif
+
+#include "potato-shard.h"
+
+static void setConnected(PbShard* shard, bool connected)
+{
+  pbMutexLock(&shard->mutex);
+  shard->connected = connected;
+  pbMutexUnlock(&shard->mutex);
+}
+
+/*
+ * Send ping without waiting for response. Response
+ * is consumed by event loop in shardTask.
+ */
+static int shardPing(PbShard* shard)
+{
+  int st;
+
+  pbMutexLock(&shard->mutex);
+
+  st = pbWritePing(&shard->out);
+  if (st >= 0)
+    st = pbWritePacket(&shard->client, &shard->out);
+
+  pbMutexUnlock(&shard->mutex);
+  return st;
+}
+
+/*
+ * Sleep for retry delay, but wake up early if
+ * sharded client is being stopped.
+ */
+static void retrySleep(PbShardedClient* sc)
+{
+  int left = sc->retryDelay;
+  int step;
+
+  while (left > 0 && !sc->stop) {
+
+    step = left < 100 ? left : 100;
+    pbSleep(step);
+    left -= step;
+  }
+}
+
+/*
+ * Task that keeps one shard connected and processes
+ * packets from broker.
+ */
+static void shardTask(void* arg)
+{
+  PbShard*         shard = (PbShard*)arg;
+  PbShardedClient* sc = shard->owner;
+  PbConnect        cd;
+  PbPublish        pub;
+  int              type;
+  int              st;
+
+  cd = sc->connect;
+  cd.clientId = shard->clientId;
+
+  while (!sc->stop) {
+
+    // TLS handshakes install key export callback into
+    // shared sslConf, so they must not run simultaneously.
+    if (cd.sslConf != NULL)
+      pbMutexLock(&sc->connectMutex);
+
+    st = pbConnect(&shard->client, sc->url, &cd);
+
+    if (cd.sslConf != NULL)
+      pbMutexUnlock(&sc->connectMutex);
+
+    if (st < 0) {
+
+      retrySleep(sc);
+      continue;
+    }
+
+    setConnected(shard, true);
+
+    while (!sc->stop) {
+
+      type = pbEvent(&shard->client);
+      if (type == PB_TIMEOUT) {
+
+        // Stopped socket looks like idle one, don't
+        // write to it.
+        if (sc->stop || shardPing(shard) < 0)
+          break;
+
+        continue;
+      }
+
+      if (type < 0)
+        break;
+
+      if (type == PB_MQ_PUBLISH && sc->received != NULL) {
+
+        memset(&pub, '\0', sizeof(pub));
+        pbReadPublish(pbRxPacket(&shard->client), &pub);
+        sc->received(sc, shard - sc->shards, &pub);
+      }
+    }
+
+    setConnected(shard, false);
+
+    // Publishers only shut socket down on errors,
+    // it is closed here when nobody else uses it.
+    pbMutexLock(&shard->mutex);
+    if (shard->client.sock != -1)
+      pbDisconnectSocket(&shard->client);
+
+    shard->reconnects++;
+    pbMutexUnlock(&shard->mutex);
+
+    retrySleep(sc);
+  }
+
+  pbMutexLock(&shard->mutex);
+  shard->running = false;
+  pbMutexUnlock(&shard->mutex);
+}
+
+int pbShardStart(PbShardedClient* sc, const char* url, const PbConnect* arg, int shards)
+{
+  PbShard* shard;
+  int      i;
+
+  if (shards < 1 || shards > POTATO_SHARDS)
+    return PB_ERROR;
+
+  if (strlen(url) >= sizeof(sc->url))
+    return PB_BADURL;
+
+#if POTATO_TLS
+  // Reader task and publishers share the connection,
+  // which is possible only if kernel handles TLS records.
+  if (arg->sslConf != NULL && (!POTATO_KTLS || arg->sockOpts == NULL || !arg->sockOpts->ktls))
+    return PB_ERROR;
+#endif
+
+  strcpy(sc->url, url);
+  sc->connect    = *arg;
+  sc->shardCount = 0;
+  sc->stop       = false;
+  if (sc->retryDelay == 0)
+    sc->retryDelay = 10000;
+
+  if (pbMutexInit(&sc->connectMutex) != PB_SUCCESS)
+    return PB_ERROR;
+
+  for (i = 0; i < shards; i++) {
+
+    shard = sc->shards + i;
+    shard->owner      = sc;
+    shard->connected  = false;
+    shard->running    = false;
+    shard->reconnects = 0;
+    pbClientInit(&shard->client);
+    shard->client.shared = true;
+    pbNewPacket(&shard->out);
+    snprintf(shard->clientId, sizeof(shard->clientId), "%s-%d", arg->clientId, i);
+
+    if (pbMutexInit(&shard->mutex) != PB_SUCCESS)
+      goto failed;
+
+    sc->shardCount = i + 1;
+    shard->running = true;
+    if (pbTaskCreate(shardTask, shard, "PbShard") != PB_SUCCESS) {
+
+      shard->running = false;
+      goto failed;
+    }
+  }
+
+  return PB_SUCCESS;
+
+failed:
+  pbShardStop(sc);
+  return PB_ERROR;
+}
+
+void pbShardStop(PbShardedClient* sc)
+{
+  PbShard* shard;
+  bool     running;
+  int      i;
+
+  sc->stop = true;
+
+  // Wake up readers blocked in pbEvent.
+  for (i = 0; i < sc->shardCount; i++) {
+
+    shard = sc->shards + i;
+    pbMutexLock(&shard->mutex);
+    shard->connected = false;
+    if (shard->client.sock != -1)
+      shutdown(shard->client.sock, SHUT_RDWR);
+
+    pbMutexUnlock(&shard->mutex);
+  }
+
+  do {
+
+    running = false;
+    for (i = 0; i < sc->shardCount; i++) {
+
+      shard = sc->shards + i;
+      pbMutexLock(&shard->mutex);
+      running = running || shard->running;
+      pbMutexUnlock(&shard->mutex);
+    }
+
+    if (running)
+      pbSleep(10);
+
+  } while (running);
+
+  for (i = 0; i < sc->shardCount; i++)
+    pbMutexDestroy(&sc->shards[i].mutex);
+
+  pbMutexDestroy(&sc->connectMutex);
+}
+
+int pbShardOf(PbShardedClient* sc, const char* topic)
+{
+  return pbHash(PB_HASH_INIT, topic, strlen(topic)) % sc->shardCount;
+}
+
+int pbShardPublish(PbShardedClient* sc, PbPublish* pub)
+{
+  PbShard* shard;
+  int      st;
+
+  shard = sc->shards + pbShardOf(sc, pub->topic);
+
+  pbMutexLock(&shard->mutex);
+
+  if (!shard->connected) {
+
+    pbMutexUnlock(&shard->mutex);
+    return PB_NETWORK;
+  }
+
+  pub->packetId = pbGetPacketId(&shard->client);
+  st = pbWritePublish(&shard->out, pub);
+  if (st >= 0)
+    st = pbWritePacket(&shard->client, &shard->out);
+
+  if (st == PB_NETWORK)
+    shard->connected = false;
+
+  pbMutexUnlock(&shard->mutex);
+
+  if (st < 0)
+    return st;
+
+  return PB_SUCCESS;
+}
+
+bool pbShardConnected(PbShardedClient* sc, int shard)
+{
+  return sc->shards[shard].connected;
+}
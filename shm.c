@@ -0,0 +1,621 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "potato-shm.h"
+
+#if POTATO_SHM
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "potato-port.h"
+#include "potato-stats.h"
+
+#define RECORD_ALIGN 16
+#define ALIGN(n) (((n) + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1))
+
+static unsigned char* ringData(PbShmRing* ring)
+{
+  return (unsigned char*)(ring + 1);
+}
+
+static PbShmRecord* ringRecord(PbShmRing* ring, uint64_t pos)
+{
+  return (PbShmRecord*)(ringData(ring) + (pos & (ring->size - 1)));
+}
+
+/*
+ * Futex is shared between processes, so
+ * private futex operations cannot be used.
+ */
+static void futexWait(uint32_t* addr, uint32_t val, int ms)
+{
+  struct timespec ts;
+
+  ts.tv_sec  = ms / 1000;
+  ts.tv_nsec = (ms % 1000) * 1000000L;
+  syscall(SYS_futex, addr, FUTEX_WAIT, val, ms > 0 ? &ts : NULL, NULL, 0);
+}
+
+static void futexWake(uint32_t* addr)
+{
+  syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/*
+ * Append packet to ring.
+ */
+static void append(PbShmRing* ring, const unsigned char* buf, int len, uint32_t topicHash)
+{
+  PbShmRecord* rec;
+  uint64_t     start;
+  uint32_t     need = ALIGN(sizeof(PbShmRecord) + len);
+  uint32_t     pad;
+  uint32_t     off;
+
+  // Reserve space. Record doesn't wrap, so if it doesn't
+  // fit to end of ring, reserve padding up to end also.
+  start = __atomic_load_n(&ring->reserve, __ATOMIC_RELAXED);
+  do {
+
+    off = start & (ring->size - 1);
+    pad = off + need > ring->size ? ring->size - off : 0;
+  } while (!__atomic_compare_exchange_n(&ring->reserve, &start, start + pad + need,
+                                        true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+  if (pad) {
+
+    rec = ringRecord(ring, start);
+    rec->len = 0;
+    __atomic_store_n(&rec->pos, start, __ATOMIC_RELEASE);
+    start += pad;
+  }
+
+  rec = ringRecord(ring, start);
+  rec->len = len;
+  rec->topicHash = topicHash;
+  memcpy(rec + 1, buf, len);
+  __atomic_store_n(&rec->pos, start, __ATOMIC_RELEASE);
+
+  // Pairs with fence in consumer after it has
+  // announced itself as waiter.
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&ring->waiters, __ATOMIC_RELAXED) > 0) {
+
+    __atomic_fetch_add(&ring->wake, 1, __ATOMIC_RELEASE);
+    futexWake(&ring->wake);
+  }
+}
+
+static uint32_t topicHash(const unsigned char* buf, int len)
+{
+  const unsigned char* topic;
+  int                  topicLen;
+
+  topicLen = pbPublishTopic(buf, len, &topic);
+  if (topicLen < 0)
+    return 0;
+
+  return pbHash(PB_HASH_INIT, topic, topicLen);
+}
+
+static bool wanted(PbShm* shm, uint32_t hash)
+{
+  int i;
+
+  for (i = 0; i < shm->filterCount; i++)
+    if (shm->filters[i].wild || shm->filters[i].hash == hash)
+      return true;
+
+  return false;
+}
+
+static bool matches(PbShm* shm, const unsigned char* buf, int len)
+{
+  const unsigned char* topic;
+  char                 name[POTATO_BUFSIZE];
+  int                  topicLen;
+  int                  i;
+
+  topicLen = pbPublishTopic(buf, len, &topic);
+  if (topicLen < 0)
+    return false;
+
+  memcpy(name, topic, topicLen);
+  name[topicLen] = '\0';
+
+  for (i = 0; i < shm->filterCount; i++)
+    if (pbTopicMatch(shm->filters[i].filter, name))
+      return true;
+
+  return false;
+}
+
+/*
+ * Get next matching record into rx buffer.
+ * Returns false if there is none available.
+ */
+static bool fetch(PbShm* shm)
+{
+  PbShmRing*   ring = shm->ring;
+  PbShmRecord* rec;
+  uint64_t     cur;
+  uint32_t     len;
+  uint32_t     hash;
+  bool         copy;
+
+  while (true) {
+
+    cur = shm->cursor;
+    rec = ringRecord(ring, cur);
+
+    if (__atomic_load_n(&rec->pos, __ATOMIC_ACQUIRE) != cur) {
+
+      // Either record is not complete yet or it has
+      // been overwritten by producers.
+      if (__atomic_load_n(&ring->reserve, __ATOMIC_ACQUIRE) - cur <= ring->size)
+        return false;
+
+      goto overrun;
+    }
+
+    len  = rec->len;
+    hash = rec->topicHash;
+    copy = len > 0 && len <= sizeof(shm->rx) &&
+           (cur & (ring->size - 1)) + sizeof(PbShmRecord) + len <= ring->size &&
+           wanted(shm, hash);
+    if (copy)
+      memcpy(shm->rx, rec + 1, len);
+
+    // If producers have not reserved over the record
+    // while it was read, data is consistent.
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&ring->reserve, __ATOMIC_RELAXED) - cur > ring->size)
+      goto overrun;
+
+    if (len == 0)
+      shm->cursor = cur + ring->size - (cur & (ring->size - 1));
+    else
+      shm->cursor = cur + ALIGN(sizeof(PbShmRecord) + len);
+
+    if (copy && matches(shm, shm->rx, len)) {
+
+      shm->rxPos = 0;
+      shm->rxLen = len;
+      return true;
+    }
+
+    continue;
+
+overrun:
+    // Continue from newest record.
+    shm->cursor = __atomic_load_n(&ring->reserve, __ATOMIC_ACQUIRE);
+    ++shm->dropped;
+  }
+}
+
+static bool waitData(PbShm* shm)
+{
+  PbShmRing* ring = shm->ring;
+  int64_t    deadline = 0;
+  int64_t    left = 0;
+  uint32_t   wake;
+  bool       got;
+
+  if (shm->timeout > 0)
+    deadline = pbClock() + shm->timeout * 1000LL;
+
+  while (!fetch(shm)) {
+
+    if (shm->timeout > 0) {
+
+      left = (deadline - pbClock()) / 1000;
+      if (left <= 0)
+        return false;
+    }
+
+    wake = __atomic_load_n(&ring->wake, __ATOMIC_ACQUIRE);
+    __atomic_fetch_add(&ring->waiters, 1, __ATOMIC_SEQ_CST);
+
+    got = fetch(shm);
+    if (!got)
+      futexWait(&ring->wake, wake, left);
+
+    __atomic_fetch_sub(&ring->waiters, 1, __ATOMIC_RELAXED);
+    if (got)
+      break;
+  }
+
+  return true;
+}
+
+static void reply(PbShm* shm, PbPacket* pkt)
+{
+  int len = pkt->end - pkt->start;
+
+  if (pkt->overflow || shm->replyLen + len > (int)sizeof(shm->reply))
+    return;
+
+  memcpy(shm->reply + shm->replyLen, pkt->start, len);
+  shm->replyLen += len;
+}
+
+static void handleConnect(PbShm* shm, const unsigned char* buf, int len)
+{
+  PbConnectAck ack;
+  PbPacket     pkt;
+  int          pos;
+  int          keepAlive;
+
+  // Keepalive follows protocol name, level and flags.
+  pos = 1;
+  while (pos < len && (buf[pos++] & 0x80))
+    ;
+
+  if (pos + 2 <= len) {
+
+    pos += 2 + ((buf[pos] << 8) | buf[pos + 1]) + 2;
+    if (pos + 2 <= len) {
+
+      // Same read timeout that pbConnect sets for sockets.
+      keepAlive = (buf[pos] << 8) | buf[pos + 1];
+      shm->timeout = keepAlive >= 2 ? keepAlive / 2 * 1000 : keepAlive * 500;
+    }
+  }
+
+  // New connection sees only new messages.
+  shm->cursor = __atomic_load_n(&shm->ring->reserve, __ATOMIC_ACQUIRE);
+  shm->filterCount = 0;
+
+  memset(&ack, '\0', sizeof(ack));
+  pbNewPacket(&pkt);
+  pbWriteConnectAck(&pkt, &ack);
+  reply(shm, &pkt);
+}
+
+static int findFilter(PbShm* shm, const char* filter)
+{
+  int i;
+
+  for (i = 0; i < shm->filterCount; i++)
+    if (!strcmp(shm->filters[i].filter, filter))
+      return i;
+
+  return -1;
+}
+
+static void handleSubscribe(PbShm* shm, const unsigned char* buf, int len, bool add)
+{
+  PbPacket     pkt;
+  PbSubscribe  sub;
+  PbShmFilter* f;
+  uint8_t      codes[POTATO_SHM_FILTERS];
+  int          count = 0;
+  int          i;
+
+  // Parsing modifies packet, so work on copy.
+  if (len > (int)sizeof(pkt.buf))
+    return;
+
+  pbNewPacket(&pkt);
+  memcpy(pkt.buf, buf, len);
+  pkt.start = pkt.ptr = pkt.buf;
+  pkt.end   = pkt.buf + len;
+
+  memset(&sub, '\0', sizeof(sub));
+  while ((add ? pbReadSubscribe(&pkt, &sub) : pbReadUnsubscribe(&pkt, &sub)) == 1) {
+
+    i = findFilter(shm, sub.topic);
+    if (!add) {
+
+      if (i != -1)
+        shm->filters[i] = shm->filters[--shm->filterCount];
+
+      continue;
+    }
+
+    if (count == POTATO_SHM_FILTERS)
+      break;
+
+    if (i == -1 && (shm->filterCount == POTATO_SHM_FILTERS || strlen(sub.topic) >= POTATO_SHM_FILTER_LEN)) {
+
+      codes[count++] = 0x80;
+      continue;
+    }
+
+    if (i == -1) {
+
+      f = &shm->filters[shm->filterCount++];
+      strcpy(f->filter, sub.topic);
+      f->wild = strpbrk(sub.topic, "+#") != NULL;
+      f->hash = pbHash(PB_HASH_INIT, sub.topic, strlen(sub.topic));
+    }
+
+    codes[count++] = 0;
+  }
+
+  if (add)
+    pbWriteSubAck(&pkt, sub.packetId, codes, count);
+  else
+    pbWriteUnsubAck(&pkt, sub.packetId);
+
+  reply(shm, &pkt);
+}
+
+static int shmWrite(PbClient* client, const unsigned char* buf, size_t len)
+{
+  PbShm*   shm = client->shm;
+  PbPacket pkt;
+
+  if (client->stats != NULL)
+    client->stats->writes++;
+
+  switch (buf[0] >> 4) {
+    case PB_MQ_CONNECT:
+      handleConnect(shm, buf, len);
+      break;
+
+    case PB_MQ_PUBLISH:
+      // Record larger than ring would be written past
+      // end of shared mapping, drop it.
+      if (ALIGN(sizeof(PbShmRecord) + len) > shm->ring->size) {
+
+        if (client->stats != NULL)
+          client->stats->tooBig++;
+
+        break;
+      }
+
+      append(shm->ring, buf, len, topicHash(buf, len));
+      break;
+
+    case PB_MQ_SUBSCRIBE:
+      handleSubscribe(shm, buf, len, true);
+      break;
+
+    case PB_MQ_UNSUBSCRIBE:
+      handleSubscribe(shm, buf, len, false);
+      break;
+
+    case PB_MQ_PINGREQ:
+      pbNewPacket(&pkt);
+      pbWritePingResp(&pkt);
+      reply(shm, &pkt);
+      break;
+
+    default:
+      break;
+  }
+
+  return len;
+}
+
+static int shmRead(PbClient* client, unsigned char* buf, size_t len)
+{
+  PbShm* shm = client->shm;
+
+  if (client->stats != NULL)
+    client->stats->reads++;
+
+  if (shm->replyLen > 0) {
+
+    if (len > (size_t)shm->replyLen)
+      len = shm->replyLen;
+
+    memcpy(buf, shm->reply, len);
+    shm->replyLen -= len;
+    memmove(shm->reply, shm->reply + len, shm->replyLen);
+    return len;
+  }
+
+  if (shm->rxPos == shm->rxLen && !waitData(shm)) {
+
+    errno = EAGAIN;
+    return -1;
+  }
+
+  if (len > (size_t)(shm->rxLen - shm->rxPos))
+    len = shm->rxLen - shm->rxPos;
+
+  memcpy(buf, shm->rx + shm->rxPos, len);
+  shm->rxPos += len;
+  return len;
+}
+
+static int shmFlush(PbClient* client)
+{
+  return 0;
+}
+
+static int shmClose(PbClient* client)
+{
+  PbShm* shm = client->shm;
+
+  if (shm->ring != NULL) {
+
+    munmap(shm->ring, shm->mapSize);
+    shm->ring = NULL;
+  }
+
+  return close(client->sock);
+}
+
+static int segmentName(char* buf, int max, const char* name)
+{
+  if (name == NULL || name[0] == '\0' || strchr(name, '/') != NULL)
+    return -1;
+
+  if (snprintf(buf, max, "/potato-%s", name) >= max)
+    return -1;
+
+  return 0;
+}
+
+/*
+ * Open segment, creating and initializing it if
+ * it doesn't exist.
+ */
+static PbShmRing* openRing(const char* name, int* fd, size_t* mapSize)
+{
+  PbShmRing*  ring;
+  struct stat st;
+  bool        created = false;
+  int         tries;
+
+  *fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (*fd != -1) {
+
+    created = true;
+    if (ftruncate(*fd, sizeof(PbShmRing) + POTATO_SHM_SIZE) == -1) {
+
+      close(*fd);
+      shm_unlink(name);
+      return NULL;
+    }
+  }
+  else if (errno == EEXIST)
+    *fd = shm_open(name, O_RDWR, 0600);
+
+  if (*fd == -1)
+    return NULL;
+
+  // Wait for creator to set size.
+  for (tries = 0; fstat(*fd, &st) == 0 && st.st_size < (off_t)sizeof(PbShmRing); tries++) {
+
+    if (tries == 100) {
+
+      close(*fd);
+      return NULL;
+    }
+
+    pbSleep(10);
+  }
+
+  *mapSize = st.st_size;
+  ring = mmap(NULL, *mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+  if (ring == MAP_FAILED) {
+
+    close(*fd);
+    return NULL;
+  }
+
+  if (created) {
+
+    ring->version     = PB_SHM_VERSION;
+    ring->size        = POTATO_SHM_SIZE;
+    ring->recordAlign = RECORD_ALIGN;
+    __atomic_store_n(&ring->magic, PB_SHM_MAGIC, __ATOMIC_RELEASE);
+  }
+
+  for (tries = 0; __atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) != PB_SHM_MAGIC; tries++) {
+
+    if (tries == 100)
+      goto bad;
+
+    pbSleep(10);
+  }
+
+  if (ring->version != PB_SHM_VERSION || ring->recordAlign != RECORD_ALIGN ||
+      ring->size == 0 || (ring->size & (ring->size - 1)) ||
+      sizeof(PbShmRing) + ring->size > *mapSize)
+    goto bad;
+
+  return ring;
+
+bad:
+  munmap(ring, *mapSize);
+  close(*fd);
+  return NULL;
+}
+
+int pbShmAttach(PbClient* client, const PbUrl* url)
+{
+  PbShm* shm = client->shm;
+  char   name[NAME_MAX];
+  int    fd;
+
+  if (shm == NULL)
+    return PB_ERROR;
+
+  if (segmentName(name, sizeof(name), url->host) == -1)
+    return PB_BADURL;
+
+  if (shm->ring != NULL) {
+
+    munmap(shm->ring, shm->mapSize);
+    shm->ring = NULL;
+  }
+
+  shm->ring = openRing(name, &fd, &shm->mapSize);
+  if (shm->ring == NULL)
+    return PB_NETWORK;
+
+  shm->cursor      = __atomic_load_n(&shm->ring->reserve, __ATOMIC_ACQUIRE);
+  shm->timeout     = 0;
+  shm->filterCount = 0;
+  shm->replyLen    = 0;
+  shm->rxPos       = 0;
+  shm->rxLen       = 0;
+
+  // Descriptor keeps client code that closes
+  // socket on errors happy.
+  client->sock            = fd;
+  client->corked          = false;
+  client->writePacket     = shmWrite;
+  client->readPacket      = shmRead;
+  client->flushPacket     = shmFlush;
+  client->closeConnection = shmClose;
+  return PB_SUCCESS;
+}
+
+int pbShmUnlink(const char* name)
+{
+  char buf[NAME_MAX];
+
+  if (segmentName(buf, sizeof(buf), name) == -1)
+    return PB_BADURL;
+
+  return shm_unlink(buf) == 0 ? PB_SUCCESS : PB_ERROR;
+}
+
+#endif
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "potato-stats.h"
+#include "potato-json.h"
+#include "potato-port.h"
+
+static const char* const typeNames[16] = {
+  NULL,        "CONNECT",     "CONNACK",  "PUBLISH",
+  "PUBACK",    "PUBREC",      "PUBREL",   "PUBCOMP",
+  "SUBSCRIBE", "SUBACK",      "UNSUBSCRIBE", "UNSUBACK",
+  "PINGREQ",   "PINGRESP",    "DISCONNECT",  NULL
+};
+
+static void countTopic(PbStats* stats, const unsigned char* topic, int topicLen, int bytes)
+{
+  uint32_t      hash;
+  PbTopicStats* t;
+  PbTopicStats* least;
+  int           len;
+
+  hash  = pbHash(PB_HASH_INIT, topic, topicLen);
+  least = stats->topics;
+
+  for (t = stats->topics; t < stats->topics + POTATO_STATS_TOPICS; t++) {
+
+    if (t->messages > 0 && t->hash == hash) {
+
+      t->messages++;
+      t->bytes += bytes;
+      return;
+    }
+
+    if (t->messages < least->messages)
+      least = t;
+  }
+
+  // Replace least active topic. New topic takes over its
+  // count, so frequent topics eventually stay in table.
+  len = topicLen;
+  if (len > POTATO_STATS_TOPIC_LEN - 1)
+    len = POTATO_STATS_TOPIC_LEN - 1;
+
+  least->hash     = hash;
+  least->error    = least->messages;
+  least->messages = least->messages + 1;
+  least->bytes    = bytes;
+  memcpy(least->topic, topic, len);
+  least->topic[len] = '\0';
+}
+
+void pbStatsReset(PbStats* stats)
+{
+  memset(stats->sent, '\0', sizeof(stats->sent));
+  memset(stats->received, '\0', sizeof(stats->received));
+  memset(stats->topics, '\0', sizeof(stats->topics));
+
+  stats->reads        = 0;
+  stats->writes       = 0;
+  stats->partialReads = 0;
+  stats->connects     = 0;
+  stats->reconnects   = 0;
+  stats->tooBig       = 0;
+  stats->timeouts     = 0;
+}
+
+void pbStatsPacket(PbStats* stats, bool sent, const unsigned char* buf, int len)
+{
+  PbCounter*           c;
+  int                  type;
+  int                  topicLen;
+  const unsigned char* topic;
+
+  if (len < 2)
+    return;
+
+  type = buf[0] >> 4;
+  c = sent ? &stats->sent[type] : &stats->received[type];
+  c->packets++;
+  c->bytes += len;
+
+  topicLen = pbPublishTopic(buf, len, &topic);
+  if (topicLen >= 0)
+    countTopic(stats, topic, topicLen, len);
+}
+
+static void writeCounters(JsonNode* root, const char* key, const PbCounter* counters)
+{
+  JsonNode* obj;
+  JsonNode* arr;
+  int       i;
+
+  jsonWriteKey(root, key);
+  obj = jsonStartObject(root);
+  if (obj == NULL)
+    return;
+
+  for (i = 0; i < 16; i++) {
+
+    if (counters[i].packets == 0 || typeNames[i] == NULL)
+      continue;
+
+    jsonWriteKey(obj, typeNames[i]);
+    arr = jsonStartArray(obj);
+    if (arr == NULL)
+      return;
+
+    jsonWriteUnsigned(arr, counters[i].packets);
+    jsonWriteUnsigned(arr, counters[i].bytes);
+  }
+}
+
+static void writeValue(JsonNode* node, const char* key, uint32_t value)
+{
+  jsonWriteKey(node, key);
+  jsonWriteUnsigned(node, value);
+}
+
+int pbStatsJson(const PbStats* stats, char* buf, int size)
+{
+  JsonContext ctx;
+  JsonNode*   root;
+  JsonNode*   arr;
+  JsonNode*   obj;
+  int         i;
+
+  memset(&ctx, '\0', sizeof(ctx));
+  root = jsonStartObject(jsonGenerate(&ctx, buf, size));
+
+  writeCounters(root, "tx", stats->sent);
+  writeCounters(root, "rx", stats->received);
+  writeValue(root, "reads", stats->reads);
+  writeValue(root, "writes", stats->writes);
+  writeValue(root, "partialReads", stats->partialReads);
+  writeValue(root, "connects", stats->connects);
+  writeValue(root, "reconnects", stats->reconnects);
+  writeValue(root, "tooBig", stats->tooBig);
+  writeValue(root, "timeouts", stats->timeouts);
+
+  jsonWriteKey(root, "topics");
+  arr = jsonStartArray(root);
+  for (i = 0; arr != NULL && i < POTATO_STATS_TOPICS; i++) {
+
+    if (stats->topics[i].messages == 0)
+      continue;
+
+    obj = jsonStartObject(arr);
+    if (obj == NULL)
+      break;
+
+    jsonWriteKey(obj, "topic");
+    jsonWriteString(obj, stats->topics[i].topic);
+    writeValue(obj, "messages", stats->topics[i].messages);
+    writeValue(obj, "bytes", stats->topics[i].bytes);
+    writeValue(obj, "error", stats->topics[i].error);
+  }
+
+  jsonGenerateFlush(root);
+  if (jsonFailed(&ctx))
+    return PB_TOOBIG;
+
+  return ctx.pos - buf;
+}
+
+int pbStatsPublish(PbClient* client)
+{
+  PbPacket* pkt = &client->packet;
+  int       len;
+
+  // Generate JSON directly after topic in packet buffer,
+  // so no separate buffer is needed.
+  pbInitPacket(pkt);
+  pbWriteString(pkt, client->stats->topic);
+  if (pkt->overflow)
+    len = PB_TOOBIG;
+  else
+    len = pbStatsJson(client->stats, (char*)pkt->end, pbRoomLeft(pkt));
+
+  if (len < 0) {
+
+    client->stats->tooBig++;
+    return len;
+  }
+
+  pkt->end += len;
+  pbWriteHeader(pkt, PB_MQ_PUBLISH, 0, pbLength(pkt));
+  if (pbWritePacket(client, pkt) < 0)
+    return PB_NETWORK;
+
+  return PB_SUCCESS;
+}
+
+int pbStatsPoll(PbClient* client)
+{
+  PbStats* stats = client->stats;
+  int64_t  now;
+
+  if (stats->topic == NULL || stats->interval <= 0)
+    return PB_SUCCESS;
+
+  now = pbClock();
+  if (stats->lastPublish == 0) {
+
+    // Start interval from first poll.
+    stats->lastPublish = now;
+    return PB_SUCCESS;
+  }
+
+  if (now - stats->lastPublish < (int64_t)stats->interval * 1000)
+    return PB_SUCCESS;
+
+  stats->lastPublish = now;
+  return pbStatsPublish(client);
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "potato-timer.h"
+#include "potato-port.h"
+
+#define SLOT_MASK (PB_TIMER_SLOTS - 1)
+
+static void detach(PbTimerWheel* wheel, PbTimer* timer)
+{
+  if (timer->next != NULL)
+    timer->next->pprev = timer->pprev;
+
+  *timer->pprev = timer->next;
+  timer->pprev = NULL;
+  --wheel->count;
+}
+
+/*
+ * Put timer to lowest level where its slot is less than
+ * full round ahead of current slot on that level.
+ */
+static void place(PbTimerWheel* wheel, PbTimer* timer)
+{
+  PbTimer** slot;
+  uint64_t  expires = timer->expires;
+  int       level;
+  int       shift;
+
+  for (level = 0; level < POTATO_TIMER_LEVELS; level++) {
+
+    shift = level * PB_TIMER_BITS;
+    if ((expires >> shift) - (wheel->now >> shift) < PB_TIMER_SLOTS)
+      break;
+  }
+
+  if (level == POTATO_TIMER_LEVELS) {
+
+    // Too far, park in last slot of top level. It is
+    // placed again when slot is reached.
+    level = POTATO_TIMER_LEVELS - 1;
+    shift = level * PB_TIMER_BITS;
+    expires = wheel->now + ((uint64_t)SLOT_MASK << shift);
+  }
+
+  slot = &wheel->slots[level][(expires >> shift) & SLOT_MASK];
+
+  timer->next = *slot;
+  if (timer->next != NULL)
+    timer->next->pprev = &timer->next;
+
+  timer->pprev = slot;
+  *slot = timer;
+  ++wheel->count;
+}
+
+/*
+ * Move timers in slot of higher level down.
+ */
+static void cascade(PbTimerWheel* wheel, int level)
+{
+  PbTimer** slot;
+  PbTimer*  timer;
+  int       shift = level * PB_TIMER_BITS;
+
+  slot = &wheel->slots[level][(wheel->now >> shift) & SLOT_MASK];
+  while ((timer = *slot) != NULL) {
+
+    detach(wheel, timer);
+    place(wheel, timer);
+  }
+}
+
+static uint64_t currentTick(PbTimerWheel* wheel)
+{
+  return (pbClock() - wheel->start) / POTATO_TIMER_TICK;
+}
+
+void pbTimerWheelInit(PbTimerWheel* wheel)
+{
+  memset(wheel, '\0', sizeof(PbTimerWheel));
+  wheel->start = pbClock();
+}
+
+int pbTimerWheelRun(PbTimerWheel* wheel)
+{
+  PbTimer** slot;
+  PbTimer*  timer;
+  uint64_t  target = currentTick(wheel);
+  int       fired = 0;
+  int       level;
+
+  while (wheel->now < target) {
+
+    if (wheel->count == 0) {
+
+      wheel->now = target;
+      break;
+    }
+
+    ++wheel->now;
+
+    // Cascade from highest level whose slot changed.
+    for (level = 1; level < POTATO_TIMER_LEVELS; level++)
+      if ((wheel->now & (((uint64_t)1 << (level * PB_TIMER_BITS)) - 1)) != 0)
+        break;
+
+    while (--level > 0)
+      cascade(wheel, level);
+
+    // Timer function may start other timers,
+    // so take expired ones one by one.
+    slot = &wheel->slots[0][wheel->now & SLOT_MASK];
+    while ((timer = *slot) != NULL) {
+
+      detach(wheel, timer);
+      timer->func(timer->ctx);
+      ++fired;
+    }
+  }
+
+  return fired;
+}
+
+int pbTimerWheelNext(PbTimerWheel* wheel)
+{
+  uint64_t best = UINT64_MAX;
+  uint64_t at;
+  int      level;
+  int      shift;
+  int      i;
+
+  if (wheel->count == 0)
+    return -1;
+
+  for (level = 0; level < POTATO_TIMER_LEVELS; level++) {
+
+    shift = level * PB_TIMER_BITS;
+    for (i = 1; i < PB_TIMER_SLOTS; i++) {
+
+      if (wheel->slots[level][((wheel->now >> shift) + i) & SLOT_MASK] != NULL) {
+
+        // Slot is reached (and cascaded) at this tick.
+        at = ((wheel->now >> shift) + i) << shift;
+        if (at < best)
+          best = at;
+
+        break;
+      }
+    }
+  }
+
+  if (best == UINT64_MAX)
+    return 0;
+
+  return ((best - wheel->now) * POTATO_TIMER_TICK + 999) / 1000;
+}
+
+void pbTimerInit(PbTimer* timer, void (*func)(void* ctx), void* ctx)
+{
+  memset(timer, '\0', sizeof(PbTimer));
+  timer->func = func;
+  timer->ctx  = ctx;
+}
+
+void pbTimerStart(PbTimerWheel* wheel, PbTimer* timer, int ms)
+{
+  uint64_t ticks = ((uint64_t)ms * 1000 + POTATO_TIMER_TICK - 1) / POTATO_TIMER_TICK;
+
+  if (timer->pprev != NULL)
+    detach(wheel, timer);
+
+  // Current tick has been handled already.
+  if (ticks == 0)
+    ticks = 1;
+
+  timer->expires = wheel->now + ticks;
+  place(wheel, timer);
+}
+
+void pbTimerCancel(PbTimerWheel* wheel, PbTimer* timer)
+{
+  if (timer->pprev != NULL)
+    detach(wheel, timer);
+}
+
+bool pbTimerPending(const PbTimer* timer)
+{
+  return timer->pprev != NULL;
+}
@@ -0,0 +1,545 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Microbenchmarks for packet codec and JSON hot paths.
+ * Each benchmark runs over a small corpus of representative
+ * payloads and reports nanoseconds and bytes processed per
+ * operation.
+ *
+ * Parsers modify their input (topic and value termination),
+ * so read benchmarks restore input before each operation and
+ * that copy is included in the result.
+ *
+ * Usage: pbbench [-j] [-t ms] [-r runs] [filter]
+ *   -j   print results as JSON lines
+ *   -t   minimum time per run (default 200 ms)
+ *   -r   runs per benchmark, median is reported (default 5)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "potato-bus.h"
+#include "potato-json.h"
+#include "potato-port.h"
+#include "mjson.h"
+
+#define MAX_RUNS 15
+
+typedef struct {
+
+  const char* name;
+  const char* topic;
+  int         len;
+} Payload;
+
+typedef struct {
+
+  const char* name;
+  const char* json;
+} JsonDoc;
+
+typedef struct {
+
+  const char* name;
+  const char* corpus;
+  int       (*setup)(int corpus);  // returns number of corpus entries, 0 = not applicable
+  long      (*run)(long iterations); // returns bytes processed
+} Bench;
+
+static const Payload payloads[] = {
+  { "small",  "s/1",                          16  },
+  { "medium", "site/42/sensors/temperature",  256 },
+  { "large",  "site/42/gateways/7/telemetry", 900 },
+};
+
+static const JsonDoc docs[] = {
+  { "sensor",    "{\"id\":42,\"temp\":21.5,\"hum\":40,\"name\":\"kitchen\"}" },
+  { "telemetry", "{\"device\":\"gw-17\",\"ts\":1700000000,\"status\":{\"battery\":87,\"rssi\":-71},"
+                 "\"readings\":[21.5,21.7,21.6,21.9,22.0,22.4,22.1,21.8]}" },
+  { "array",     "[1.5,2.5,3.5,4.5,5.5,6.5,7.5,8.5,9.5,10.5,11.5,12.5,13.5,14.5,15.5,16.5]" },
+  // Binary payload that happens to start with bracket (potato-bench
+  // timestamp) and truncated document. Parser must stop on these.
+  { "binary",    "[\x1c\x9a\x5b\x07" },
+  { "truncated", "{\"device\":\"gw-17\",\"readings\":[21.5,21.7" },
+};
+
+#define NPAYLOADS (int)(sizeof(payloads) / sizeof(payloads[0]))
+#define NDOCS     (int)(sizeof(docs) / sizeof(docs[0]))
+
+static unsigned char  message[POTATO_BUFSIZE];
+static const Payload* payload;
+static const JsonDoc* doc;
+static PbPacket       pkt;
+static PbPacket       original;
+static int            restoreLen;
+static PbClient       client;
+static unsigned char  stream[64 * 1024];
+static int            streamLen;
+static int            streamPos;
+static char           work[1024];
+static volatile long  sink;
+
+// microjson target for sensor document.
+static int    mjId;
+static double mjTemp;
+static int    mjHum;
+static char   mjName[32];
+
+static const struct json_attr_t sensorAttrs[] = {
+  { "id",   t_integer, .addr.integer = &mjId },
+  { "temp", t_real,    .addr.real = &mjTemp },
+  { "hum",  t_integer, .addr.integer = &mjHum },
+  { "name", t_string,  .addr.string = mjName, .len = sizeof(mjName) },
+  { NULL },
+};
+
+/*
+ * Setup functions.
+ */
+
+static int payloadSetup(int corpus)
+{
+  PbPublish pub;
+
+  if (corpus >= NPAYLOADS)
+    return 0;
+
+  payload = &payloads[corpus];
+  memset(message, 'x', sizeof(message));
+
+  memset(&pub, '\0', sizeof(pub));
+  pub.topic   = payload->topic;
+  pub.message = message;
+  pub.len     = payload->len;
+
+  pbNewPacket(&pkt);
+  pbNewPacket(&original);
+  pbWritePublish(&original, &pub);
+
+  // Header, topic length and topic get modified by reader.
+  restoreLen = (original.end - original.start) - payload->len;
+  return NPAYLOADS;
+}
+
+static int singleSetup(int corpus)
+{
+  return corpus == 0 ? 1 : 0;
+}
+
+static int memRead(PbClient* c, unsigned char* buf, size_t len)
+{
+  if (streamPos == streamLen)
+    streamPos = 0;
+
+  if (len > (size_t)(streamLen - streamPos))
+    len = streamLen - streamPos;
+
+  memcpy(buf, stream + streamPos, len);
+  streamPos += len;
+  return len;
+}
+
+static int streamSetup(int corpus)
+{
+  int n = payloadSetup(corpus);
+  int len = original.end - original.start;
+
+  if (n == 0)
+    return 0;
+
+  // Fill stream with whole packets.
+  streamLen = 0;
+  streamPos = 0;
+  while (streamLen + len <= (int)sizeof(stream)) {
+
+    memcpy(stream + streamLen, original.start, len);
+    streamLen += len;
+  }
+
+  pbClientInit(&client);
+  client.readPacket = memRead;
+  return n;
+}
+
+static int docSetup(int corpus)
+{
+  if (corpus >= NDOCS)
+    return 0;
+
+  doc = &docs[corpus];
+  return NDOCS;
+}
+
+static int sensorSetup(int corpus)
+{
+  return docSetup(corpus) ? 1 : 0;
+}
+
+/*
+ * Benchmarks.
+ */
+
+static long benchWritePublish(long n)
+{
+  PbPublish pub;
+  long      i;
+
+  memset(&pub, '\0', sizeof(pub));
+  pub.topic   = payload->topic;
+  pub.message = message;
+  pub.len     = payload->len;
+
+  for (i = 0; i < n; i++) {
+
+    pbWritePublish(&pkt, &pub);
+    sink += pkt.end - pkt.start;
+  }
+
+  return n * (pkt.end - pkt.start);
+}
+
+static long benchWriteConnect(long n)
+{
+  PbConnect conn;
+  long      i;
+
+  memset(&conn, '\0', sizeof(conn));
+  conn.clientId  = "gateway-0042";
+  conn.user      = "device";
+  conn.pass      = "secret";
+  conn.keepAlive = 60;
+
+  for (i = 0; i < n; i++) {
+
+    pbWriteConnect(&pkt, &conn);
+    sink += pkt.end - pkt.start;
+  }
+
+  return n * (pkt.end - pkt.start);
+}
+
+static long benchWriteSubscribe(long n)
+{
+  PbSubscribe sub;
+  long        i;
+
+  memset(&sub, '\0', sizeof(sub));
+  sub.topic    = "site/42/sensors/+/temperature";
+  sub.packetId = 1;
+
+  for (i = 0; i < n; i++) {
+
+    pbWriteSubscribe(&pkt, &sub);
+    sink += pkt.end - pkt.start;
+  }
+
+  return n * (pkt.end - pkt.start);
+}
+
+static long benchReadPacket(long n)
+{
+  long i;
+  long bytes = 0;
+  PbPacket* rx;
+
+  for (i = 0; i < n; i++) {
+
+    sink += pbReadPacket(&client);
+    rx = pbRxPacket(&client);
+    bytes += rx->end - rx->start;
+  }
+
+  return bytes;
+}
+
+static long benchReadPublish(long n)
+{
+  PbPublish pub;
+  long      i;
+
+  pkt = original;
+  pkt.start = pkt.buf + (original.start - original.buf);
+  pkt.end   = pkt.buf + (original.end - original.buf);
+  memset(&pub, '\0', sizeof(pub));
+
+  for (i = 0; i < n; i++) {
+
+    memcpy(pkt.start, original.start, restoreLen);
+    pkt.ptr = pkt.start;
+    pbReadPublish(&pkt, &pub);
+    sink += pub.len;
+  }
+
+  return n * (pkt.end - pkt.start);
+}
+
+static int walk(JsonNode* node)
+{
+  JsonNode* n;
+  int       count = 0;
+
+  while ((n = jsonNext(node)) != NULL) {
+
+    ++count;
+    if (jsonIsObject(n) || jsonIsArray(n))
+      count += walk(n);
+  }
+
+  return count;
+}
+
+static long benchJsonParse(long n)
+{
+  JsonContext ctx;
+  JsonNode*   root;
+  int         len = strlen(doc->json) + 1;
+  long        i;
+
+  for (i = 0; i < n; i++) {
+
+    memcpy(work, doc->json, len);
+    root = jsonParse(&ctx, work);
+    sink += walk(root);
+  }
+
+  return n * (len - 1);
+}
+
+static long benchJsonFind(long n)
+{
+  JsonContext ctx;
+  JsonNode*   root;
+  JsonNode*   node;
+  int         len = strlen(doc->json) + 1;
+  long        i;
+
+  for (i = 0; i < n; i++) {
+
+    memcpy(work, doc->json, len);
+    root = jsonParse(&ctx, work);
+    node = jsonFind(root, "hum");
+    if (node != NULL)
+      sink += jsonReadInteger(node);
+  }
+
+  return n * (len - 1);
+}
+
+static long benchJsonGenerate(long n)
+{
+  JsonContext ctx;
+  JsonNode*   root;
+  JsonNode*   arr;
+  long        i;
+  long        bytes = 0;
+  int         v;
+
+  for (i = 0; i < n; i++) {
+
+    root = jsonStartObject(jsonGenerate(&ctx, work, sizeof(work)));
+    jsonWriteKey(root, "device");
+    jsonWriteString(root, "gw-17");
+    jsonWriteKey(root, "ts");
+    jsonWriteInteger(root, 1700000000);
+    jsonWriteKey(root, "readings");
+    arr = jsonStartArray(root);
+    for (v = 0; v < 8; v++)
+      jsonWriteDouble(arr, 21.5 + v * 0.1);
+
+    jsonGenerateFlush(root);
+    bytes += ctx.pos - work;
+  }
+
+  sink += bytes;
+  return bytes;
+}
+
+static long benchMjsonRead(long n)
+{
+  int  len = strlen(doc->json);
+  long i;
+
+  for (i = 0; i < n; i++) {
+
+    json_read_object(doc->json, sensorAttrs, NULL);
+    sink += mjId;
+  }
+
+  return n * len;
+}
+
+static long benchMjsonWrite(long n)
+{
+  long i;
+  long bytes = 0;
+
+  mjId   = 42;
+  mjTemp = 21.5;
+  mjHum  = 40;
+  strcpy(mjName, "kitchen");
+
+  for (i = 0; i < n; i++) {
+
+    json_write_object(work, sensorAttrs, sizeof(work));
+    bytes += strlen(work);
+  }
+
+  sink += bytes;
+  return bytes;
+}
+
+static const Bench benches[] = {
+  { "pbWritePublish",   "payload",  payloadSetup, benchWritePublish },
+  { "pbWriteConnect",   NULL,       singleSetup,  benchWriteConnect },
+  { "pbWriteSubscribe", NULL,       singleSetup,  benchWriteSubscribe },
+  { "pbReadPacket",     "payload",  streamSetup,  benchReadPacket },
+  { "pbReadPublish",    "payload",  payloadSetup, benchReadPublish },
+  { "jsonParse+jsonNext", "json",   docSetup,     benchJsonParse },
+  { "jsonParse+jsonFind", "json",   sensorSetup,  benchJsonFind },
+  { "jsonGenerate",     NULL,       singleSetup,  benchJsonGenerate },
+  { "json_read_object", "json",     sensorSetup,  benchMjsonRead },
+  { "json_write_object", NULL,      singleSetup,  benchMjsonWrite },
+  { NULL }
+};
+
+static int compare(const void* a, const void* b)
+{
+  double x = *(const double*)a;
+  double y = *(const double*)b;
+
+  return x < y ? -1 : x > y;
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: pbbench [-j] [-t ms] [-r runs] [filter]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv)
+{
+  const Bench* b;
+  const char*  filter = NULL;
+  const char*  corpus;
+  bool         jsonOut = false;
+  int          minTime = 200;
+  int          runs = 5;
+  int          count;
+  int          c;
+  int          r;
+  int          opt;
+  long         n;
+  long         bytes = 0;
+  int64_t      elapsed;
+  double       ns[MAX_RUNS];
+  double       nsOp;
+  double       bytesOp;
+
+  while ((opt = getopt(argc, argv, "jt:r:")) != -1) {
+
+    switch (opt) {
+      case 'j':
+        jsonOut = true;
+        break;
+
+      case 't':
+        minTime = atoi(optarg);
+        break;
+
+      case 'r':
+        runs = atoi(optarg);
+        if (runs < 1 || runs > MAX_RUNS)
+          usage();
+        break;
+
+      default:
+        usage();
+    }
+  }
+
+  if (optind < argc)
+    filter = argv[optind];
+
+  if (!jsonOut)
+    printf("%-20s %-10s %12s %10s %10s\n", "benchmark", "corpus", "ns/op", "bytes/op", "MB/s");
+
+  for (b = benches; b->name != NULL; b++) {
+
+    if (filter != NULL && strstr(b->name, filter) == NULL)
+      continue;
+
+    for (c = 0; (count = b->setup(c)) > 0 && c < count; c++) {
+
+      corpus = "-";
+      if (b->corpus != NULL)
+        corpus = b->setup == payloadSetup || b->setup == streamSetup ? payload->name : doc->name;
+
+      // Calibrate iteration count to reach minimum run time.
+      n = 1;
+      do {
+
+        n *= 2;
+        elapsed = pbClock();
+        bytes = b->run(n);
+        elapsed = pbClock() - elapsed;
+      } while (elapsed < minTime * 100L);
+
+      n = n * (minTime * 1000L) / (elapsed > 0 ? elapsed : 1) + 1;
+
+      for (r = 0; r < runs; r++) {
+
+        elapsed = pbClock();
+        bytes = b->run(n);
+        elapsed = pbClock() - elapsed;
+        ns[r] = elapsed * 1000.0 / n;
+      }
+
+      qsort(ns, runs, sizeof(double), compare);
+      nsOp    = ns[runs / 2];
+      bytesOp = (double)bytes / n;
+
+      if (jsonOut)
+        printf("{\"benchmark\":\"%s\",\"corpus\":\"%s\",\"iterations\":%ld,"
+               "\"ns_per_op\":%.2f,\"bytes_per_op\":%.1f,\"mb_per_s\":%.2f}\n",
+               b->name, corpus, n, nsOp, bytesOp, bytesOp * 1000.0 / nsOp);
+      else
+        printf("%-20s %-10s %12.2f %10.1f %10.2f\n",
+               b->name, corpus, nsOp, bytesOp, bytesOp * 1000.0 / nsOp);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Stand-in MQTT broker for tests and benchmarks, using
+ * embedded broker. Listens on given URLs (default
+ * mqtt://127.0.0.1:1883) and optionally prints message
+ * counters every interval seconds.
+ *
+ * Usage: pbbroker [-u url] [-u url] [-v seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "potato-bus.h"
+#include "potato-port.h"
+#include "potato-broker.h"
+
+static PbBroker              broker;
+static volatile sig_atomic_t done;
+
+static void stop(int sig)
+{
+  done = 1;
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: pbbroker [-u url] [-u url] [-v seconds]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv)
+{
+  const char* urls[POTATO_BROKER_LISTEN];
+  int         count = 0;
+  int         interval = 0;
+  int64_t     next;
+  int         opt;
+  int         i;
+  int         st;
+
+  while ((opt = getopt(argc, argv, "u:v:")) != -1) {
+
+    switch (opt) {
+      case 'u':
+        if (count == POTATO_BROKER_LISTEN)
+          usage();
+
+        urls[count++] = optarg;
+        break;
+
+      case 'v':
+        interval = atoi(optarg);
+        break;
+
+      default:
+        usage();
+    }
+  }
+
+  if (count == 0)
+    urls[count++] = "mqtt://127.0.0.1:1883";
+
+  if (pbBrokerInit(&broker) != PB_SUCCESS) {
+
+    perror("pbBrokerInit");
+    return 1;
+  }
+
+  for (i = 0; i < count; i++) {
+
+    st = pbBrokerListen(&broker, urls[i]);
+    if (st != PB_SUCCESS) {
+
+      fprintf(stderr, "%s: cannot listen (%d)\n", urls[i], st);
+      return 1;
+    }
+  }
+
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+
+  next = pbClock() + interval * 1000000LL;
+  while (!done) {
+
+    if (pbBrokerPoll(&broker, 1000) < 0)
+      break;
+
+    if (interval > 0 && pbClock() >= next) {
+
+      printf("published %u delivered %u dropped %u\n",
+             broker.published, broker.delivered, broker.dropped);
+      fflush(stdout);
+      next += interval * 1000000LL;
+    }
+  }
+
+  pbBrokerClose(&broker);
+  return 0;
+}
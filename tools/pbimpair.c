@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Throughput benchmark over impaired link. A broker thread
+ * streams PUBLISH packets over unix socket while client reads
+ * them through impairment layer. Prints throughput and client
+ * statistics (reads, partial reads, timeouts).
+ *
+ * Usage: pbimpair [-n messages] [-m size] [-k keepalive] [-l latency-ms]
+ *                 [-j jitter-ms] [-b bytes/s] [-r max-read]
+ *                 [-s bytes:ms] [-d bytes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "potato-bus.h"
+#include "potato-port.h"
+#include "potato-impair.h"
+#include "potato-stats.h"
+
+#define SOCK_PATH "/tmp/pbimpair.sock"
+
+static int             messages = 10000;
+static int             size = 100;
+static int             listenSock;
+static int             brokerSock = -1;
+static pthread_mutex_t writeMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int writeAll(int sock, const unsigned char* buf, int len)
+{
+  int st;
+
+  pthread_mutex_lock(&writeMutex);
+  while (len > 0) {
+
+    st = write(sock, buf, len);
+    if (st <= 0)
+      break;
+
+    buf += st;
+    len -= st;
+  }
+
+  pthread_mutex_unlock(&writeMutex);
+  return len == 0 ? 0 : -1;
+}
+
+/*
+ * Answer CONNECT and PINGREQ, ignore everything else.
+ */
+static void* brokerReader(void* arg)
+{
+  static const unsigned char connAck[] = { 0x20, 0x02, 0x00, 0x00 };
+  static const unsigned char pingResp[] = { 0xd0, 0x00 };
+  unsigned char buf[256];
+  int           len;
+  int           i;
+
+  while ((len = read(brokerSock, buf, sizeof(buf))) > 0) {
+
+    // Packets from client are small, so first byte of
+    // each read is enough to spot interesting ones.
+    for (i = 0; i < len; i++) {
+
+      if (buf[i] == 0x10) {
+
+        writeAll(brokerSock, connAck, sizeof(connAck));
+        break;
+      }
+
+      if (buf[i] == 0xc0 && i + 1 < len && buf[i + 1] == 0x00)
+        writeAll(brokerSock, pingResp, sizeof(pingResp));
+    }
+  }
+
+  return NULL;
+}
+
+static void* broker(void* arg)
+{
+  PbPacket      pkt;
+  PbPublish     pub;
+  pthread_t     reader;
+  unsigned char payload[POTATO_BUFSIZE];
+  int           i;
+
+  brokerSock = accept(listenSock, NULL, NULL);
+  if (brokerSock == -1)
+    return NULL;
+
+  pthread_create(&reader, NULL, brokerReader, NULL);
+
+  // Give client time to see CONNACK first.
+  pbSleep(50);
+
+  memset(payload, 'x', sizeof(payload));
+  memset(&pub, '\0', sizeof(pub));
+  pub.topic   = "bench/data";
+  pub.message = payload;
+  pub.len     = size;
+
+  pbNewPacket(&pkt);
+  pbWritePublish(&pkt, &pub);
+
+  for (i = 0; i < messages; i++)
+    if (writeAll(brokerSock, pkt.start, pbLength(&pkt)) < 0)
+      break;
+
+  return NULL;
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: pbimpair [-n messages] [-m size] [-k keepalive] [-l latency-ms]\n"
+                  "                [-j jitter-ms] [-b bytes/s] [-r max-read]\n"
+                  "                [-s bytes:ms] [-d bytes]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv)
+{
+  static PbClient    client;
+  static PbImpair    impair;
+  static PbStats     stats;
+  PbConnect          conn;
+  struct sockaddr_un addr;
+  pthread_t          thread;
+  int64_t            start;
+  int64_t            elapsed;
+  int                keepAlive = 10;
+  int                type = 0;
+  int                opt;
+  uint32_t           received;
+
+  while ((opt = getopt(argc, argv, "n:m:k:l:j:b:r:s:d:")) != -1) {
+
+    switch (opt) {
+      case 'n':
+        messages = atoi(optarg);
+        break;
+
+      case 'm':
+        size = atoi(optarg);
+        break;
+
+      case 'k':
+        keepAlive = atoi(optarg);
+        break;
+
+      case 'l':
+        impair.latency = atoi(optarg);
+        break;
+
+      case 'j':
+        impair.jitter = atoi(optarg);
+        break;
+
+      case 'b':
+        impair.bandwidth = atoi(optarg);
+        break;
+
+      case 'r':
+        impair.maxRead = atoi(optarg);
+        break;
+
+      case 's':
+        if (sscanf(optarg, "%d:%d", &impair.stallEvery, &impair.stallTime) != 2)
+          usage();
+        break;
+
+      case 'd':
+        impair.disconnectAfter = atol(optarg);
+        break;
+
+      default:
+        usage();
+    }
+  }
+
+  if (size < 1 || size > POTATO_BUFSIZE - 32)
+    usage();
+
+  unlink(SOCK_PATH);
+  memset(&addr, '\0', sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, SOCK_PATH);
+
+  listenSock = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenSock == -1 ||
+      bind(listenSock, (struct sockaddr*)&addr, sizeof(addr)) == -1 ||
+      listen(listenSock, 1) == -1) {
+
+    perror(SOCK_PATH);
+    return 1;
+  }
+
+  pthread_create(&thread, NULL, broker, NULL);
+
+  memset(&conn, '\0', sizeof(conn));
+  conn.clientId  = "pbimpair";
+  conn.keepAlive = keepAlive;
+
+  pbClientInit(&client);
+  client.impair = &impair;
+  client.stats  = &stats;
+  if (pbConnect(&client, "unix://" SOCK_PATH, &conn) != PB_SUCCESS) {
+
+    fprintf(stderr, "cannot connect\n");
+    return 1;
+  }
+
+  start = pbClock();
+  while (stats.received[PB_MQ_PUBLISH].packets < (uint32_t)messages) {
+
+    type = pbEvent(&client);
+    if (type == PB_TIMEOUT)
+      type = pbPing(&client);
+
+    if (type < 0 && type != PB_TIMEOUT)
+      break;
+  }
+
+  elapsed = pbClock() - start;
+  if (elapsed < 1)
+    elapsed = 1;
+
+  received = stats.received[PB_MQ_PUBLISH].packets;
+  printf("%u/%d messages, %u bytes in %.3f s%s\n",
+         received, messages, stats.received[PB_MQ_PUBLISH].bytes,
+         elapsed / 1000000.0, type < 0 && type != PB_TIMEOUT ? " (disconnected)" : "");
+  printf("%.0f messages/s, %.1f kB/s\n",
+         received * 1000000.0 / elapsed,
+         stats.received[PB_MQ_PUBLISH].bytes * 1000.0 / elapsed);
+  printf("reads %u, partial reads %u, timeouts %u, pings %u\n",
+         stats.reads, stats.partialReads, stats.timeouts, stats.sent[PB_MQ_PINGREQ].packets);
+
+  unlink(SOCK_PATH);
+  return 0;
+}
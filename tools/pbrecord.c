@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Offline decoder for flight recorder dumps (see potato-record.h).
+ * Prints a timeline of recorded packets and errors and marks
+ * gaps longer than given limit.
+ *
+ * Usage: pbrecord [-g gap-ms] dump-file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#define HEADER_SIZE 24
+#define EVENT_SIZE  16
+
+static const char* const typeNames[16] = {
+  "RESERVED",  "CONNECT",     "CONNACK",  "PUBLISH",
+  "PUBACK",    "PUBREC",      "PUBREL",   "PUBCOMP",
+  "SUBSCRIBE", "SUBACK",      "UNSUBSCRIBE", "UNSUBACK",
+  "PINGREQ",   "PINGRESP",    "DISCONNECT",  "RESERVED"
+};
+
+static const char* errorName(int32_t error)
+{
+  switch (error) {
+    case -1:
+      return "PB_ERROR";
+
+    case -2:
+      return "PB_TOOBIG";
+
+    case -3:
+      return "PB_NETWORK";
+
+    case -4:
+      return "PB_TIMEOUT";
+
+    case -5:
+      return "PB_MBEDTLS";
+
+    case -6:
+      return "PB_BADURL";
+
+    case -7:
+      return "PB_HTTP";
+
+    default:
+      return "error";
+  }
+}
+
+static uint16_t get16(const unsigned char* ptr)
+{
+  return ptr[0] | (ptr[1] << 8);
+}
+
+static uint32_t get32(const unsigned char* ptr)
+{
+  return get16(ptr) | ((uint32_t)get16(ptr + 2) << 16);
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: pbrecord [-g gap-ms] dump-file\n");
+  exit(2);
+}
+
+int main(int argc, char** argv)
+{
+  FILE*         f;
+  unsigned char hdr[HEADER_SIZE];
+  unsigned char ev[EVENT_SIZE];
+  uint32_t      count;
+  uint32_t      dropped;
+  uint32_t      dumpTime;
+  uint32_t      i;
+  uint32_t      last = 0;
+  int64_t       now = 0;
+  int64_t       prev = 0;
+  double        gap = 1000.0;
+  int           opt;
+
+  while ((opt = getopt(argc, argv, "g:")) != -1) {
+
+    if (opt == 'g')
+      gap = atof(optarg);
+    else
+      usage();
+  }
+
+  if (optind != argc - 1)
+    usage();
+
+  f = fopen(argv[optind], "rb");
+  if (f == NULL) {
+
+    perror(argv[optind]);
+    return 1;
+  }
+
+  if (fread(hdr, 1, sizeof(hdr), f) != sizeof(hdr) || memcmp(hdr, "PBFR", 4)) {
+
+    fprintf(stderr, "%s: not a flight recorder dump\n", argv[optind]);
+    return 1;
+  }
+
+  if (get16(hdr + 4) != 1 || get16(hdr + 6) != EVENT_SIZE) {
+
+    fprintf(stderr, "%s: unsupported version %d\n", argv[optind], get16(hdr + 4));
+    return 1;
+  }
+
+  count    = get32(hdr + 8);
+  dropped  = get32(hdr + 12);
+  dumpTime = get32(hdr + 16);
+
+  printf("# %u events, %u older events overwritten\n", count, dropped);
+  printf("%12s %10s  %-5s %-11s %5s %6s  %s\n",
+         "time ms", "delta ms", "dir", "type", "id", "len", "topic");
+
+  for (i = 0; i < count; i++) {
+
+    if (fread(ev, 1, sizeof(ev), f) != sizeof(ev)) {
+
+      fprintf(stderr, "%s: truncated dump\n", argv[optind]);
+      return 1;
+    }
+
+    uint32_t t = get32(ev);
+
+    // Timestamps are low 32 bits of microsecond clock,
+    // unwrap them using previous event.
+    if (i > 0)
+      now += (uint32_t)(t - last);
+
+    last = t;
+
+    double delta = (now - prev) / 1000.0;
+    if (i > 0 && delta >= gap)
+      printf("%12s %10s  --- gap %.3f s ---\n", "", "", delta / 1000.0);
+
+    printf("%12.3f %10.3f  ", now / 1000.0, delta);
+    prev = now;
+
+    if (ev[4] == 2) {
+
+      int32_t error = (int32_t)get32(ev + 8);
+
+      printf("%-5s %s (%d)\n", "err", errorName(error), error);
+      continue;
+    }
+
+    printf("%-5s %-11s %5u %6u", ev[4] ? "rx" : "tx", typeNames[ev[5] >> 4], get16(ev + 6), get32(ev + 8));
+    if (ev[5] >> 4 == 3)
+      printf("  %08x", get32(ev + 12));
+
+    printf("\n");
+  }
+
+  if (count > 0)
+    printf("# dump taken %.3f ms after last event\n", (uint32_t)(dumpTime - last) / 1000.0);
+
+  fclose(f);
+  return 0;
+}
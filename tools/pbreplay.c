@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Capture MQTT traffic from a broker and replay it through
+ * client decode pipeline (pbReadPacket, pbReadPublish, topic
+ * dispatch and JSON parsing) to measure its throughput.
+ *
+ * Usage: pbreplay -c url [-t topic] [-s seconds] capture-file
+ *        pbreplay [-r] [-n iterations] capture-file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "potato-bus.h"
+#include "potato-json.h"
+#include "potato-port.h"
+#include "potato-capture.h"
+
+// Subscriptions used for dispatch benchmark.
+static const char* const filters[] = {
+  "sensors/+/temperature",
+  "sensors/+/humidity",
+  "devices/#",
+  "status",
+  NULL
+};
+
+static PbClient client;
+static long     hits[sizeof(filters) / sizeof(filters[0])];
+
+static int walk(JsonNode* node)
+{
+  JsonNode* n;
+  int       count = 0;
+
+  while ((n = jsonNext(node)) != NULL) {
+
+    ++count;
+    if (jsonIsObject(n) || jsonIsArray(n))
+      count += walk(n);
+  }
+
+  return count;
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: pbreplay -c url [-t topic] [-s seconds] capture-file\n"
+                  "       pbreplay [-r] [-n iterations] capture-file\n");
+  exit(2);
+}
+
+static int capture(const char* url, const char* topic, int seconds, const char* path)
+{
+  PbCapture   cap;
+  PbConnect   conn;
+  PbSubscribe sub;
+  int64_t     end;
+  int         type;
+  long        count = 0;
+
+  if (pbCaptureOpen(&cap, path) != PB_SUCCESS) {
+
+    perror(path);
+    return 1;
+  }
+
+  memset(&conn, '\0', sizeof(conn));
+  conn.clientId  = "pbreplay";
+  conn.keepAlive = 30;
+
+  pbClientInit(&client);
+  client.capture = &cap;
+  if (pbConnect(&client, url, &conn) != PB_SUCCESS) {
+
+    fprintf(stderr, "%s: cannot connect\n", url);
+    return 1;
+  }
+
+  memset(&sub, '\0', sizeof(sub));
+  sub.topic = topic;
+  if (pbSubscribe(&client, &sub) < 0) {
+
+    fprintf(stderr, "%s: cannot subscribe\n", topic);
+    return 1;
+  }
+
+  end = pbClock() + (int64_t)seconds * 1000000;
+  while (pbClock() < end) {
+
+    type = pbEvent(&client);
+    if (type == PB_TIMEOUT) {
+
+      if (pbPing(&client) < 0)
+        break;
+
+      continue;
+    }
+
+    if (type < 0)
+      break;
+
+    if (type == PB_MQ_PUBLISH)
+      ++count;
+  }
+
+  pbDisconnect(&client);
+  if (pbCaptureClose(&cap) != PB_SUCCESS) {
+
+    perror(path);
+    return 1;
+  }
+
+  printf("captured %ld messages\n", count);
+  return 0;
+}
+
+static int replay(const char* path, int iterations, bool realtime)
+{
+  PbReplay       rp;
+  PbPublish      pub;
+  JsonContext    json;
+  JsonNode*      root;
+  unsigned char* data;
+  size_t         size;
+  int64_t        start;
+  int64_t        elapsed;
+  long           packets = 0;
+  long           messages = 0;
+  long           values = 0;
+  long           malformed = 0;
+  long           bytes = 0;
+  int            type;
+  int            i;
+  int            f;
+
+  data = pbReplayLoad(path, &size);
+  if (data == NULL) {
+
+    perror(path);
+    return 1;
+  }
+
+  start = pbClock();
+  for (i = 0; i < iterations; i++) {
+
+    if (pbReplayStart(&client, &rp, data, size, realtime) != PB_SUCCESS) {
+
+      fprintf(stderr, "%s: not a capture file\n", path);
+      return 1;
+    }
+
+    while (!pbReplayEnd(&rp)) {
+
+      type = pbEvent(&client);
+      if (type < 0)
+        continue;
+
+      ++packets;
+      bytes += pbLength(pbRxPacket(&client));
+      if (type != PB_MQ_PUBLISH)
+        continue;
+
+      ++messages;
+      pbReadPublish(pbRxPacket(&client), &pub);
+
+      for (f = 0; filters[f] != NULL; f++)
+        if (pbTopicMatch(filters[f], pub.topic))
+          ++hits[f];
+
+      // Binary payloads may start with bracket too,
+      // parser stops on them and they are counted.
+      if (pub.len > 0 && (pub.message[0] == '{' || pub.message[0] == '[')) {
+
+        root = jsonParse(&json, (char*)pub.message);
+        if (root != NULL)
+          values += walk(root);
+
+        if (jsonFailed(&json))
+          ++malformed;
+      }
+    }
+
+    pbDisconnectSocket(&client);
+  }
+
+  elapsed = pbClock() - start;
+  if (elapsed < 1)
+    elapsed = 1;
+
+  printf("%ld packets, %ld messages, %ld json values, %ld bytes in %.3f ms\n",
+         packets, messages, values, bytes, elapsed / 1000.0);
+
+  if (malformed > 0)
+    printf("%ld messages with malformed json\n", malformed);
+
+  if (packets > 0)
+    printf("%.1f ns/packet, %.0f packets/s, %.2f MB/s\n",
+           elapsed * 1000.0 / packets,
+           packets * 1000000.0 / elapsed,
+           bytes / (double)elapsed);
+
+  for (f = 0; filters[f] != NULL; f++)
+    printf("  %-24s %ld\n", filters[f], hits[f]);
+
+  free(data);
+  return 0;
+}
+
+int main(int argc, char** argv)
+{
+  const char* url = NULL;
+  const char* topic = "#";
+  int         seconds = 10;
+  int         iterations = 1;
+  bool        realtime = false;
+  int         opt;
+
+  while ((opt = getopt(argc, argv, "c:t:s:n:r")) != -1) {
+
+    switch (opt) {
+      case 'c':
+        url = optarg;
+        break;
+
+      case 't':
+        topic = optarg;
+        break;
+
+      case 's':
+        seconds = atoi(optarg);
+        break;
+
+      case 'n':
+        iterations = atoi(optarg);
+        break;
+
+      case 'r':
+        realtime = true;
+        break;
+
+      default:
+        usage();
+    }
+  }
+
+  if (optind != argc - 1)
+    usage();
+
+  if (url != NULL)
+    return capture(url, topic, seconds, argv[optind]);
+
+  return replay(argv[optind], iterations, realtime);
+}
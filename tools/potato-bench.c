@@ -0,0 +1,378 @@
+/*
+ * Copyright (c) 2026, Ari Suutari <ari@stonepile.fi>.
+ * All rights reserved. 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote
+ *     products derived from this software without specific prior written
+ *     permission. 
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT,  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * MQTT load generator. Opens a number of publisher connections,
+ * which publish at given total rate (or as fast as possible) to
+ * a set of topics. Optional subscriber connections receive the
+ * messages and measure end-to-end latency from timestamp
+ * embedded in payload. Url may also be shm://name for shared
+ * memory transport.
+ *
+ * Usage: potato-bench [-u url] [-c publishers] [-s subscribers]
+ *                     [-r rate] [-m size] [-t topics] [-d seconds]
+ *                     [-b batch] [-j]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "potato-bus.h"
+#include "potato-port.h"
+#include "potato-latency.h"
+#include "potato-shm.h"
+
+#define MAX_THREADS 256
+
+typedef struct {
+
+  pthread_t   thread;
+  int         index;
+  PbClient    client;
+  PbShm       shm;             // for shm:// urls
+  long        messages;
+  long        bytes;
+  int         error;
+  PbHistogram latency;
+} Worker;
+
+static const char* url = "mqtt://127.0.0.1:1883";
+static int         publishers = 1;
+static int         subscribers = 0;
+static int         rate = 0;
+static int         size = 64;
+static int         topics = 1;
+static int         duration = 10;
+static int         batch = 1;
+static volatile int64_t startTime = INT64_MAX / 2;
+static volatile int64_t endTime = INT64_MAX / 2;
+static volatile int ready;
+static Worker      workers[MAX_THREADS];
+
+static int connectWorker(Worker* w, const char* role)
+{
+  PbConnect conn;
+  char      clientId[32];
+
+  snprintf(clientId, sizeof(clientId), "bench-%s-%d-%d", role, (int)getpid(), w->index);
+  memset(&conn, '\0', sizeof(conn));
+  conn.clientId  = clientId;
+  conn.keepAlive = 30;
+  pbClientInit(&w->client);
+  w->client.shm  = &w->shm;
+
+  return pbConnect(&w->client, url, &conn);
+}
+
+static void* publisher(void* arg)
+{
+  Worker*       w = arg;
+  PbPublish     pub;
+  unsigned char payload[POTATO_BUFSIZE];
+  char          topic[32];
+  int64_t       now;
+  int64_t       next;
+  int64_t       interval = 0;
+  long          seq;
+
+  w->error = connectWorker(w, "pub");
+  __sync_fetch_and_add(&ready, 1);
+  if (w->error != PB_SUCCESS)
+    return NULL;
+
+  while (pbClock() < startTime)
+    usleep(1000);
+
+  // Each publisher takes its share of total rate.
+  if (rate > 0)
+    interval = 1000000LL * publishers / rate;
+
+  memset(payload, 'x', sizeof(payload));
+  next = startTime;
+
+  for (seq = 0; (now = pbClock()) < endTime; seq++) {
+
+    if (interval > 0) {
+
+      if (next > now)
+        usleep(next - now);
+
+      next += interval;
+    }
+
+    if (batch > 1 && seq % batch == 0)
+      pbCork(&w->client, true);
+
+    snprintf(topic, sizeof(topic), "bench/%ld", (seq * publishers + w->index) % topics);
+
+    now = pbClock();
+    memcpy(payload, &now, sizeof(now));
+
+    memset(&pub, '\0', sizeof(pub));
+    pub.topic   = topic;
+    pub.message = payload;
+    pub.len     = size;
+
+    if (pbPublish(&w->client, &pub) < 0) {
+
+      w->error = PB_NETWORK;
+      break;
+    }
+
+    if (batch > 1 && seq % batch == batch - 1)
+      pbCork(&w->client, false);
+
+    w->messages++;
+    w->bytes += size;
+  }
+
+  if (batch > 1)
+    pbCork(&w->client, false);
+
+  pbDisconnect(&w->client);
+  return NULL;
+}
+
+static void* subscriber(void* arg)
+{
+  Worker*     w = arg;
+  PbSubscribe sub;
+  PbPublish   pub;
+  int64_t     sent;
+  int         type;
+
+  w->error = connectWorker(w, "sub");
+  if (w->error == PB_SUCCESS) {
+
+    memset(&sub, '\0', sizeof(sub));
+    sub.topic = "bench/#";
+    if (pbSubscribe(&w->client, &sub) < 0)
+      w->error = PB_NETWORK;
+  }
+
+  __sync_fetch_and_add(&ready, 1);
+  if (w->error != PB_SUCCESS)
+    return NULL;
+
+  // Allow a second for messages in flight after publishers stop.
+  while (pbClock() < endTime + 1000000) {
+
+    type = pbEvent(&w->client);
+    if (type == PB_TIMEOUT) {
+
+      if (pbPing(&w->client) < 0)
+        break;
+
+      continue;
+    }
+
+    if (type < 0) {
+
+      w->error = type;
+      break;
+    }
+
+    if (type != PB_MQ_PUBLISH)
+      continue;
+
+    memset(&pub, '\0', sizeof(pub));
+    pbReadPublish(pbRxPacket(&w->client), &pub);
+    if (pub.len < (int)sizeof(sent))
+      continue;
+
+    memcpy(&sent, pub.message, sizeof(sent));
+    if (sent >= startTime)
+      pbHistogramRecord(&w->latency, pbClock() - sent);
+
+    w->messages++;
+    w->bytes += pub.len;
+  }
+
+  pbDisconnect(&w->client);
+  return NULL;
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "usage: potato-bench [-u url] [-c publishers] [-s subscribers]\n"
+                  "                    [-r rate] [-m size] [-t topics] [-d seconds]\n"
+                  "                    [-b batch] [-j]\n");
+  exit(2);
+}
+
+int main(int argc, char** argv)
+{
+  PbHistogram latency;
+  bool        jsonOut = false;
+  long        sent = 0;
+  long        received = 0;
+  long        sentBytes = 0;
+  int         failed = 0;
+  int         opt;
+  int         i;
+  double      seconds;
+
+  while ((opt = getopt(argc, argv, "u:c:s:r:m:t:d:b:j")) != -1) {
+
+    switch (opt) {
+      case 'u':
+        url = optarg;
+        break;
+
+      case 'c':
+        publishers = atoi(optarg);
+        break;
+
+      case 's':
+        subscribers = atoi(optarg);
+        break;
+
+      case 'r':
+        rate = atoi(optarg);
+        break;
+
+      case 'm':
+        size = atoi(optarg);
+        break;
+
+      case 't':
+        topics = atoi(optarg);
+        break;
+
+      case 'd':
+        duration = atoi(optarg);
+        break;
+
+      case 'b':
+        batch = atoi(optarg);
+        break;
+
+      case 'j':
+        jsonOut = true;
+        break;
+
+      default:
+        usage();
+    }
+  }
+
+  if (publishers < 1 || subscribers < 0 || publishers + subscribers > MAX_THREADS ||
+      size < 8 || size > POTATO_BUFSIZE - 64 || topics < 1 || duration < 1 || batch < 1)
+    usage();
+
+  // Workers connect to same host, resolve it once.
+  pbEndpointInit();
+
+  // Start subscribers first, so that no messages are missed.
+  for (i = 0; i < subscribers; i++) {
+
+    workers[i].index = i;
+    pthread_create(&workers[i].thread, NULL, subscriber, &workers[i]);
+  }
+
+  while (ready < subscribers)
+    usleep(1000);
+
+  for (i = subscribers; i < subscribers + publishers; i++) {
+
+    workers[i].index = i - subscribers;
+    pthread_create(&workers[i].thread, NULL, publisher, &workers[i]);
+  }
+
+  while (ready < subscribers + publishers)
+    usleep(1000);
+
+  // Publishers wait for start time.
+  startTime = pbClock() + 100000;
+  endTime   = startTime + (int64_t)duration * 1000000;
+
+  for (i = 0; i < subscribers + publishers; i++)
+    pthread_join(workers[i].thread, NULL);
+
+  memset(&latency, '\0', sizeof(latency));
+  for (i = 0; i < subscribers + publishers; i++) {
+
+    if (workers[i].error != PB_SUCCESS)
+      failed++;
+
+    if (i < subscribers) {
+
+      received += workers[i].messages;
+      pbHistogramMerge(&latency, &workers[i].latency);
+    }
+    else {
+
+      sent      += workers[i].messages;
+      sentBytes += workers[i].bytes;
+    }
+  }
+
+  seconds = duration;
+  if (jsonOut) {
+
+    printf("{\"publishers\":%d,\"subscribers\":%d,\"size\":%d,\"topics\":%d,\"rate\":%d,"
+           "\"sent\":%ld,\"received\":%ld,\"failed\":%d,\"sent_per_s\":%.0f,\"received_per_s\":%.0f",
+           publishers, subscribers, size, topics, rate,
+           sent, received, failed, sent / seconds, received / seconds);
+
+    if (latency.count > 0)
+      printf(",\"latency_us\":{\"min\":%u,\"p50\":%u,\"p90\":%u,\"p99\":%u,\"p999\":%u,\"max\":%u,\"mean\":%u}",
+             latency.min, pbHistogramPercentile(&latency, 50), pbHistogramPercentile(&latency, 90),
+             pbHistogramPercentile(&latency, 99), pbHistogramPercentile(&latency, 99.9),
+             latency.max, pbHistogramMean(&latency));
+
+    printf("}\n");
+    return failed ? 1 : 0;
+  }
+
+  printf("sent      %ld messages, %.0f msg/s, %.2f MB/s (%d publishers)\n",
+         sent, sent / seconds, sentBytes / seconds / 1000000.0, publishers);
+
+  if (subscribers > 0)
+    printf("received  %ld messages, %.0f msg/s, %.1f%% of expected (%d subscribers)\n",
+           received, received / seconds,
+           sent > 0 ? 100.0 * received / ((double)sent * subscribers) : 0.0, subscribers);
+
+  if (latency.count > 0)
+    printf("latency   min %u  p50 %u  p90 %u  p99 %u  p99.9 %u  max %u  mean %u us\n",
+           latency.min, pbHistogramPercentile(&latency, 50), pbHistogramPercentile(&latency, 90),
+           pbHistogramPercentile(&latency, 99), pbHistogramPercentile(&latency, 99.9),
+           latency.max, pbHistogramMean(&latency));
+
+  if (failed)
+    printf("%d connections failed\n", failed);
+
+  return failed ? 1 : 0;
+}